@@ -60,12 +60,14 @@ OptionInt    ProgramOptions::sloShowsBScansPos (1    , "sloShowsBScansPos"   , "
 OptionBool   ProgramOptions::sloShowOverlay    (true , "sloShowOverlay"      , "ProgramOptions");
 OptionDouble ProgramOptions::sloOverlayAlpha   (0.7  , "sloOverlayAlpha"     , "ProgramOptions", 0.0, 1.0, 0.1);
 OptionBool   ProgramOptions::sloClipScanArea   (false, "sloClipScanArea"      , "ProgramOptions");
+OptionBool   ProgramOptions::sloDistanceMapCache(true, "sloDistanceMapCache"  , "ProgramOptions");
 
 
 OptionString ProgramOptions::octDirectory      (".", "octDirectory"      , "ProgramOptions");
 OptionString ProgramOptions::loadOctdataAtStart("" , "loadOctDataAtStart", "ProgramOptions");
 
 OptionBool   ProgramOptions::autoSaveOctMarkers         (true, "autoSaveOctMarkers", "ProgramOptions");
+OptionInt    ProgramOptions::undoMemoryBudgetMiB        (64  , "undoMemoryBudgetMiB", "ProgramOptions", 1, 4096);
 OptionInt    ProgramOptions::defaultFileformatOctMarkers(static_cast<int>(OctMarkerFileformat::INFO), "defaultFileformatOctMarkers", "ProgramOptions");
 
 OptionInt    ProgramOptions::bscanMarkerToolId(-1, "bscanMarkerToolId", "ProgramOptions");
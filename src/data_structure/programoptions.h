@@ -83,11 +83,13 @@ public:
 	static OptionBool   sloShowOverlay ;
 	static OptionDouble sloOverlayAlpha;
 	static OptionBool   sloClipScanArea;
+	static OptionBool   sloDistanceMapCache;
 	
 	static OptionString octDirectory;
 	static OptionString loadOctdataAtStart;
 	
 	static OptionBool   autoSaveOctMarkers;
+	static OptionInt    undoMemoryBudgetMiB;
 	static OptionInt    defaultFileformatOctMarkers;
 
 	static OptionInt    bscanMarkerToolId;
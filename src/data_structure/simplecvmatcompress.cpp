@@ -23,6 +23,11 @@
 /// @todo add a check of the datatype of mat
 void SimpleCvMatCompress::readFromMat(const cv::Mat& mat)
 {
+	if(!mat.isContinuous())
+	{
+		readFromMat(mat.clone()); // sub area of a bigger mat
+		return;
+	}
 	SimpleMatCompress::readFromMat(mat.ptr<uint8_t>(), mat.rows, mat.cols);
 }
 
@@ -31,12 +36,20 @@ void SimpleCvMatCompress::readFromMat(const cv::Mat& mat)
 void SimpleCvMatCompress::writeToMat(cv::Mat& mat) const
 {
 	mat.create(getRows(), getCols(), cv::DataType<uint8_t>::type);
+	if(!mat.isContinuous())
+	{
+		cv::Mat tmp;
+		writeToMat(tmp);
+		tmp.copyTo(mat); // sub area of a bigger mat, same size, no reallocation
+		return;
+	}
 	SimpleMatCompress::writeToMat(mat.ptr<uint8_t>(), mat.rows, mat.cols);
 }
 
 
 bool SimpleCvMatCompress::operator==(const cv::Mat& mat) const
 {
+	if(!mat.isContinuous())
+		return SimpleMatCompress::isEqual(mat.clone().ptr<uint8_t>(), mat.rows, mat.cols);
 	return SimpleMatCompress::isEqual(mat.ptr<uint8_t>(), mat.rows, mat.cols);
 }
-
@@ -18,6 +18,115 @@
 
 #include "simplematcompress.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <sstream>
+
+#include <boost/archive/text_iarchive.hpp>
+
+#include <helper/base64.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SIMPLEMATCOMPRESS_SSE2
+	#include<emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+	#define SIMPLEMATCOMPRESS_AVX2
+	#include<immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+	#include<intrin.h>
+#endif
+
+namespace
+{
+	namespace Constants
+	{
+		const char    textPrefix[]  = "rle1:";
+		const uint8_t binaryVersion = 1;
+	}
+
+	void appendVarint(std::string& data, uint64_t value)
+	{
+		while(value >= 0x80)
+		{
+			data.push_back(static_cast<char>(value | 0x80));
+			value >>= 7;
+		}
+		data.push_back(static_cast<char>(value));
+	}
+
+	bool readVarint(const unsigned char*& pos, const unsigned char* end, uint64_t& value)
+	{
+		value = 0;
+		for(int shift = 0; pos < end && shift < 64; shift += 7)
+		{
+			const unsigned char byte = *pos++;
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	inline int countTrailingZeros(uint32_t mask)
+	{
+		assert(mask != 0);
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	/**
+	 * first position in [pos, end) with a value other than value, end if there is none
+	 * the run is tested 32 (AVX2) or 16 (SSE2) bytes at a time
+	 */
+	const uint8_t* findRunEnd(const uint8_t* pos, const uint8_t* end, uint8_t value)
+	{
+#ifdef SIMPLEMATCOMPRESS_AVX2
+		const __m256i value32 = _mm256_set1_epi8(static_cast<char>(value));
+		while(end - pos >= 32)
+		{
+			const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+			const uint32_t diff = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, value32)));
+			if(diff)
+				return pos + countTrailingZeros(diff);
+			pos += 32;
+		}
+#endif
+#ifdef SIMPLEMATCOMPRESS_SSE2
+		const __m128i value16 = _mm_set1_epi8(static_cast<char>(value));
+		while(end - pos >= 16)
+		{
+			const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+			const uint32_t diff = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(data, value16))) & 0xFFFF;
+			if(diff)
+				return pos + countTrailingZeros(diff);
+			pos += 16;
+		}
+#else
+		const uint64_t value8 = static_cast<uint64_t>(value)*UINT64_C(0x0101010101010101);
+		while(end - pos >= 8)
+		{
+			uint64_t data;
+			std::memcpy(&data, pos, sizeof(data));
+			if(data != value8)
+				break;
+			pos += 8;
+		}
+#endif
+		while(pos < end && *pos == value)
+			++pos;
+		return pos;
+	}
+}
 
 
 SimpleMatCompress::SimpleMatCompress(int rows, int cols, uint8_t initValue)
@@ -38,27 +147,20 @@ bool SimpleMatCompress::readFromMat(const uint8_t* mat, int rows, int cols)
 	if(mat == nullptr)
 		return false;
 
-	int     actSegmentLengt = 0;
-	uint8_t actSegmentValue = *mat;
+	// masks of layers change the value a few times per row
+	segmentsChange.reserve(static_cast<std::size_t>(rows) + 1);
 
-	const uint8_t* dataPtr = mat;
-	for(int row = 0; row < rows; ++row)
+	const uint8_t*       dataPtr = mat;
+	const uint8_t* const dataEnd = mat + static_cast<std::ptrdiff_t>(rows)*cols;
+	while(dataPtr < dataEnd)
 	{
-		for(int col = 0; col < cols; ++col)
-		{
-			if(actSegmentValue != *dataPtr)
-			{
-				addSegment(actSegmentLengt, actSegmentValue);
-				actSegmentValue = *dataPtr;
-				actSegmentLengt = 1;
-			}
-			else
-				++actSegmentLengt;
-
-			++dataPtr;
-		}
+		const uint8_t  segmentValue = *dataPtr;
+		const uint8_t* segmentEnd   = findRunEnd(dataPtr + 1, dataEnd, segmentValue);
+		addSegment(static_cast<int>(segmentEnd - dataPtr), segmentValue);
+		dataPtr = segmentEnd;
 	}
-	addSegment(actSegmentLengt, actSegmentValue);
+	if(segmentsChange.empty())
+		addSegment(0, 0);
 
 	assert(sumSegments == rows*cols);
 	return true;
@@ -69,11 +171,17 @@ bool SimpleMatCompress::writeToMat(uint8_t* mat, int rows, int cols) const
 	if(this->rows != rows || this->cols != cols || mat == nullptr)
 		return false;
 
+	uint8_t* const matEnd = mat + static_cast<std::ptrdiff_t>(rows)*cols;
 	for(const MatSegment& segment : segmentsChange)
 	{
-		uint8_t segmentValue = segment.value;
-		for(int i=0; i<segment.length; ++i, ++mat)
-			*mat = segmentValue;
+		if(mat == matEnd)
+			break;
+
+		const std::ptrdiff_t length = std::min(static_cast<std::ptrdiff_t>(segment.length), matEnd - mat);
+		if(length <= 0) // zero length segments are valid in the binary format
+			continue;
+		std::memset(mat, segment.value, static_cast<std::size_t>(length));
+		mat += length;
 	}
 	return true;
 }
@@ -98,14 +206,18 @@ bool SimpleMatCompress::isEqual(const uint8_t* mat, int rows, int cols) const
 	if(this->rows != rows || this->cols != cols || mat == nullptr)
 		return false;
 
+	const uint8_t* const matEnd = mat + static_cast<std::ptrdiff_t>(rows)*cols;
 	for(const MatSegment& segment : segmentsChange)
 	{
-		uint8_t segmentValue = segment.value;
-		for(int i=0; i<segment.length; ++i, ++mat)
-			if(*mat != segmentValue)
-				return false;
+		if(segment.length > matEnd - mat)
+			return false;
+
+		const uint8_t* segmentEnd = mat + segment.length;
+		if(findRunEnd(mat, segmentEnd, segment.value) != segmentEnd)
+			return false;
+		mat = segmentEnd;
 	}
-	return true;
+	return mat == matEnd;
 }
 
 bool SimpleMatCompress::operator==(const SimpleMatCompress& other) const
@@ -115,3 +227,125 @@ bool SimpleMatCompress::operator==(const SimpleMatCompress& other) const
 	    && segmentsChange == other.segmentsChange;
 }
 
+
+/*
+ * binary run encoding:
+ *   uint8 version, varint rows, varint cols, varint number of segments
+ *   per segment: varint (length << 1 | valueFlag), value byte if valueFlag is set
+ * Without the flag the value is the value of the segment before the previous one
+ * (0 for the first two segments), so a binary mask needs no value bytes.
+ */
+void SimpleMatCompress::writeBinary(std::string& data) const
+{
+	data.clear();
+	data.reserve(16 + segmentsChange.size()*2);
+	data.push_back(static_cast<char>(Constants::binaryVersion));
+	appendVarint(data, static_cast<uint64_t>(rows));
+	appendVarint(data, static_cast<uint64_t>(cols));
+	appendVarint(data, segmentsChange.size());
+
+	uint8_t lastValues[2] = { 0, 0 };
+	for(const MatSegment& segment : segmentsChange)
+	{
+		const bool writeValue = segment.value != lastValues[0];
+		appendVarint(data, static_cast<uint64_t>(segment.length) << 1 | (writeValue ? 1 : 0));
+		if(writeValue)
+			data.push_back(static_cast<char>(segment.value));
+
+		lastValues[0] = lastValues[1];
+		lastValues[1] = segment.value;
+	}
+}
+
+bool SimpleMatCompress::readBinary(const char* data, std::size_t size)
+{
+	const unsigned char* pos = reinterpret_cast<const unsigned char*>(data);
+	const unsigned char* end = pos + size;
+
+	uint64_t rows64;
+	uint64_t cols64;
+	uint64_t numSegments;
+	if(size == 0 || *pos++ != Constants::binaryVersion
+	|| !readVarint(pos, end, rows64)
+	|| !readVarint(pos, end, cols64)
+	|| !readVarint(pos, end, numSegments))
+		return false;
+
+	const uint64_t numPixels = rows64*cols64;
+	if(rows64 > INT32_MAX || cols64 > INT32_MAX || (cols64 > 0 && numPixels/cols64 != rows64) || numPixels > INT32_MAX
+	|| numSegments > static_cast<uint64_t>(end - pos))      // at least one byte per segment
+		return false;
+
+	std::vector<MatSegment> segments;
+	segments.reserve(static_cast<std::size_t>(numSegments));
+
+	uint64_t sumLength = 0;
+	uint8_t lastValues[2] = { 0, 0 };
+	for(uint64_t i = 0; i < numSegments; ++i)
+	{
+		uint64_t code;
+		if(!readVarint(pos, end, code))
+			return false;
+
+		const uint64_t length = code >> 1;
+		sumLength += length;
+		if(sumLength > numPixels)
+			return false;
+
+		uint8_t value = lastValues[0];
+		if(code & 1)
+		{
+			if(pos == end)
+				return false;
+			value = *pos++;
+		}
+		segments.emplace_back(static_cast<int>(length), value);
+
+		lastValues[0] = lastValues[1];
+		lastValues[1] = value;
+	}
+	if(pos != end || sumLength != numPixels)
+		return false;
+
+	rows           = static_cast<int>(rows64);
+	cols           = static_cast<int>(cols64);
+	sumSegments    = static_cast<int>(sumLength);
+	segmentsChange = std::move(segments);
+	return true;
+}
+
+std::string SimpleMatCompress::toString() const
+{
+	std::string binary;
+	writeBinary(binary);
+
+	std::string base64;
+	Base64::encode(binary.data(), binary.size(), base64);
+	return Constants::textPrefix + base64;
+}
+
+bool SimpleMatCompress::fromString(const std::string& str)
+{
+	std::string buffer;
+	return fromString(str, buffer);
+}
+
+bool SimpleMatCompress::fromString(const std::string& str, std::string& buffer)
+{
+	const std::size_t prefixLength = sizeof(Constants::textPrefix) - 1;
+	if(str.compare(0, prefixLength, Constants::textPrefix) == 0)
+	{
+		if(!Base64::decode(str.data() + prefixLength, str.size() - prefixLength, buffer))
+			return false;
+		return readBinary(buffer.data(), buffer.size());
+	}
+
+	if(str.size() < 2)
+		return false;
+
+	// legacy format
+	std::stringstream ioa(str);
+	boost::archive::text_iarchive oa(ioa);
+	oa >> *this;
+	return true;
+}
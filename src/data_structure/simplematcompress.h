@@ -20,6 +20,7 @@
 #define SIMPLEMATCOMPRESS_H
 
 #include <vector>
+#include <string>
 #include <cstdint>
 
 #include <boost/serialization/vector.hpp>
@@ -82,11 +83,25 @@ public:
 	int getRows() const { return rows; }
 	int getCols() const { return cols; }
 
+	/// heap memory of the run list in bytes
+	std::size_t getMemoryUsage() const { return segmentsChange.capacity()*sizeof(MatSegment); }
+
 	bool readFromMat(const uint8_t* mat, int rows, int cols);
 	bool writeToMat (      uint8_t* mat, int rows, int cols) const;
 
 	bool isEqual(const uint8_t* mat, int rows, int cols) const;
 	bool operator==(const SimpleMatCompress& other) const;
+
+	/// compact binary run encoding (varint run lengths, value byte only when it changes)
+	void writeBinary(std::string& data) const;
+	bool readBinary (const char* data, std::size_t size);
+
+	/// text for the marker tree: binary run encoding as base64 with a "rle1:" prefix
+	std::string toString() const;
+	/// reads toString() and the legacy boost::archive::text_oarchive form
+	bool fromString(const std::string& str);
+	/// as fromString, buffer is reused for the binary data when many masks are decoded
+	bool fromString(const std::string& str, std::string& buffer);
 };
 
 
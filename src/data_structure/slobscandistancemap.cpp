@@ -23,6 +23,10 @@
 #include<map>
 #include<limits>
 #include<cmath>
+#include<chrono>
+#include<thread>
+#include<atomic>
+#include<algorithm>
 
 #include<opencv2/opencv.hpp>
 
@@ -31,6 +35,8 @@
 #include<octdata/datastruct/sloimage.h>
 
 
+#include<oct_cpp_framework/callback.h>
+
 #include<data_structure/matrx.h>
 #include<data_structure/point2d.h>
 #include <helper/slocoordtranslator.h>
@@ -41,6 +47,25 @@ namespace
 
 	typedef double DistanceType;
 
+	/// measure the duration of consecutive calculation phases, the actual phase ends with next() or the destruction
+	class PhaseTimer
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		double* actPhase;
+		Clock::time_point start = Clock::now();
+	public:
+		explicit PhaseTimer(double& phase) : actPhase(&phase) {}
+		~PhaseTimer()                                                  { stop(); }
+
+		PhaseTimer(const PhaseTimer&)            = delete;
+		PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+		void next(double& phase)                                       { stop(); actPhase = &phase; start = Clock::now(); }
+	private:
+		void stop()                                                    { *actPhase = std::chrono::duration<double, std::milli>(Clock::now() - start).count(); }
+	};
+
 	class TrailMap
 	{
 		std::vector<PixtureElement> actTrailDist;
@@ -133,10 +158,16 @@ namespace
 
 		PixelMap pixelMap;
 		TrailMap trailMap;
+		std::vector<PixtureElement> acceptedPixels; // pixels visited by the wavefront of the actual b-scan, only this pixels need a reset
 
 		SloCoordTranslator transformCoord;
+		SloBScanDistanceMap::Timings& timings;
+
+		CppFW::Callback* callback;
+		std::atomic<bool> aborted{false};
 
 		constexpr static const DistanceType maxDistance = 25;
+		constexpr static const double fracL1DistanceMap = 0.3; ///< progress fraction of the L1 phase, the rest is the L2 refinement
 		std::size_t actBscanNr = 0;
 
 		static Point2D coordSLO2Point(const OctData::CoordSLOpx& c)                { return Point2D(c.getXf(), c.getYf()); }
@@ -239,7 +270,7 @@ namespace
 
 
 		template<typename AScanHandler>
-		void addLineScan(const OctData::BScan& bscan, AScanHandler& handler)
+		void addLineScan(const OctData::BScan& bscan, AScanHandler& handler) const
 		{
 			const OctData::CoordSLOpx start_px = transformCoord(bscan.getStart());
 			const OctData::CoordSLOpx   end_px = transformCoord(bscan.getEnd()  );
@@ -262,7 +293,7 @@ namespace
 
 
 		template<typename AScanHandler>
-		void addCircleScan(const OctData::BScan& bscan, AScanHandler& handler)
+		void addCircleScan(const OctData::BScan& bscan, AScanHandler& handler) const
 		{
 			const OctData::CoordSLOpx start_px  = transformCoord(bscan.getStart ());
 			const OctData::CoordSLOpx center_px = transformCoord(bscan.getCenter());
@@ -300,7 +331,7 @@ namespace
 
 
 		template<typename AScanHandler>
-		void addBScan(const OctData::BScan& bscan, AScanHandler& pixelSetter)
+		void addBScan(const OctData::BScan& bscan, AScanHandler& pixelSetter) const
 		{
 			switch(bscan.getBScanType())
 			{
@@ -319,6 +350,8 @@ namespace
 		template<typename AScanHandler>
 		void addBScans(AScanHandler& pixelSetter, bool evaluation)
 		{
+			const std::size_t numBScans = series.bscanCount();
+
 			std::size_t bscanNr = 0;
 			for(const std::shared_ptr<const OctData::BScan>& bscan : series.getBScans())
 			{
@@ -326,10 +359,14 @@ namespace
 				if(bscan)
 					addBScan(*bscan, pixelSetter);
 
+				++bscanNr;
+
 				if(evaluation)
+				{
 					calcActDistMap();
-
-				++bscanNr;
+					if(!reportProgress(fracL1DistanceMap*static_cast<double>(bscanNr)/static_cast<double>(numBScans)))
+						return;
+				}
 			}
 		}
 
@@ -340,6 +377,7 @@ namespace
 		{
 			info.status = PixelInfo::Status::ACCEPTED;
 			info.ascan  = ascan;
+			acceptedPixels.emplace_back(x, y);
 
 			if(info.updateValue(SlideInfo(distance, actBscanNr, ascan)))
 				trailMap.emplace(distance, PixtureElement(x, y));
@@ -379,11 +417,9 @@ namespace
 
 			trailMap.clear();
 
-			for(PixelInfo& info : pixelMap) // reset map for next b-scan calculation
-			{
-				if(info.status != PixelInfo::Status::BRODER)
-					info.status = PixelInfo::Status::FAR_AWAY;
-			}
+			for(const PixtureElement& ele : acceptedPixels) // reset map for next b-scan calculation, only the visited pixels can be ACCEPTED
+				pixelMap(ele.getX(), ele.getY()).status = PixelInfo::Status::FAR_AWAY;
+			acceptedPixels.clear();
 		}
 
 		// ---------------------
@@ -470,11 +506,14 @@ namespace
 			if(sloImageMat.empty())
 				return;
 
+			PhaseTimer timer(timings.convexBroder);
 			fillConvexBroder(convexHull);
 
+			timer.next(timings.bscanBroder);
 			ValueSetter ivs(*this, false);
 			addBScans(ivs, false);
 
+			timer.next(timings.l1DistanceMap);
 			ValueSetter apvs(*this, true);
 			addBScans(apvs, true);
 
@@ -487,7 +526,7 @@ namespace
 		// finisch distance map
 		// --------------------
 
-		void recalcDistDataL2(std::size_t x, std::size_t y, SloBScanDistanceMap::InfoBScanDist& info, const SlideInfo& slideInfo)
+		void recalcDistDataL2(std::size_t x, std::size_t y, SloBScanDistanceMap::InfoBScanDist& info, const SlideInfo& slideInfo) const
 		{
 			std::size_t bscanNr = info.bscan;
 			if(bscanNr >= series.bscanCount())
@@ -503,16 +542,15 @@ namespace
 			info.distance = fmas.getMinDistance();
 		}
 
-		void fillPreCalcData()
+		void fillPreCalcDataRows(std::size_t yBegin, std::size_t yEnd) const
 		{
-			SloBScanDistanceMap::PreCalcDataMatrix::value_type* itOut = matrix.begin();
-			PixelMap::value_type* itIn = pixelMap.begin();
-
 			const std::size_t sizeX = matrix.getSizeX();
-			const std::size_t sizeY = matrix.getSizeY();
 
-			for(std::size_t y = 0; y < sizeY; ++y)
+			for(std::size_t y = yBegin; y < yEnd; ++y)
 			{
+				std::size_t outIndex = matrix.index(0, y);
+				const PixelMap::value_type* itIn = pixelMap.scanLine(y);
+
 				for(std::size_t x = 0; x < sizeX; ++x)
 				{
 					if(itIn->hasValue)
@@ -535,31 +573,137 @@ namespace
 						if(info2.distance < info1.distance)
 							std::swap(info1, info2);
 
-						itOut->bscan1 = info1;
-						itOut->bscan2 = info2;
-						itOut->init   = true;
+						matrix.setPixel(outIndex, info1, info2);
 					}
-					++itOut;
+					++outIndex;
 					++itIn;
 				}
 			}
 		}
 
+		/**
+		 * the rows are independent, they are distributed in bands over a small thread pool.
+		 * each output pixel is written by exactly one thread, so the result does not depend on the scheduling
+		 * (a band starts at a multiple of 8 pixels, so the threads do not share bytes of the init bitmask)
+		 */
+		void fillPreCalcData()
+		{
+			constexpr std::size_t rowsPerBand = 16;
+
+			const std::size_t sizeY    = matrix.getSizeY();
+			const std::size_t numBands = (sizeY + rowsPerBand - 1)/rowsPerBand;
+
+			std::atomic<std::size_t> nextBand(0);
+			std::atomic<std::size_t> finishedBands(0);
+			auto worker = [&](bool reportThread)
+			{
+				for(std::size_t band = nextBand++; band < numBands && !aborted; band = nextBand++)
+				{
+					fillPreCalcDataRows(band*rowsPerBand, std::min(sizeY, (band+1)*rowsPerBand));
+					const std::size_t finished = ++finishedBands;
+
+					if(reportThread) // the callback is only called from the thread of the caller
+						reportProgress(fracL1DistanceMap + (1. - fracL1DistanceMap)*static_cast<double>(finished)/static_cast<double>(numBands));
+				}
+			};
+
+			const std::size_t numThreads = std::min(numBands, static_cast<std::size_t>(std::max(1u, std::thread::hardware_concurrency())));
+
+			std::vector<std::thread> threads;
+			for(std::size_t i = 1; i < numThreads; ++i)
+				threads.emplace_back(worker, false);
+
+			worker(true);
+
+			for(std::thread& t : threads)
+				t.join();
+		}
+
+
+		bool reportProgress(double frac)
+		{
+			if(aborted)
+				return false;
+			if(callback && !callback->callback(frac))
+				aborted = true;
+			return !aborted;
+		}
+
 
 	public:
-		FillPreCalcData(SloBScanDistanceMap::PreCalcDataMatrix& matrix, const OctData::Series& series)
+		FillPreCalcData(SloBScanDistanceMap::PreCalcDataMatrix& matrix, const OctData::Series& series, SloBScanDistanceMap::Timings& timings, CppFW::Callback* callback)
 		: matrix(matrix)
 		, series(series)
 		, pixelMap(matrix.getSizeX(), matrix.getSizeY())
 		, transformCoord(series)
+		, timings(timings)
+		, callback(callback)
 		{
 			creatL1DistanceMap();
+			if(aborted)
+				return;
+
+			PhaseTimer timer(timings.l2Refinement);
 			fillPreCalcData();
 		}
+
+		bool success() const                                           { return !aborted; }
 	};
 }
 
 
+SloBScanDistanceMap::PreCalcDataMatrix::PreCalcDataMatrix(std::size_t sizeX, std::size_t sizeY)
+: sizeX(sizeX)
+, sizeY(sizeY)
+, initMask (((sizeX*sizeY) + 7)/8, 0)
+, distance1(sizeX*sizeY, std::numeric_limits<float>::infinity())
+, distance2(sizeX*sizeY, std::numeric_limits<float>::infinity())
+, bscan1   (sizeX*sizeY, invalidIndex)
+, ascan1   (sizeX*sizeY, invalidIndex)
+, bscan2   (sizeX*sizeY, invalidIndex)
+, ascan2   (sizeX*sizeY, invalidIndex)
+{
+}
+
+SloBScanDistanceMap::PixelInfo SloBScanDistanceMap::PreCalcDataMatrix::operator()(std::size_t x, std::size_t y) const
+{
+	const std::size_t i = index(x, y);
+
+	PixelInfo info;
+	info.init = isInit(i);
+	if(info.init)
+	{
+		info.bscan1.distance = distance1[i];
+		info.bscan1.bscan    = toSize(bscan1[i]);
+		info.bscan1.ascan    = toSize(ascan1[i]);
+		info.bscan2.distance = distance2[i];
+		info.bscan2.bscan    = toSize(bscan2[i]);
+		info.bscan2.ascan    = toSize(ascan2[i]);
+	}
+	return info;
+}
+
+void SloBScanDistanceMap::PreCalcDataMatrix::setPixel(std::size_t i, const InfoBScanDist& info1, const InfoBScanDist& info2)
+{
+	// b-scan or a-scan numbers out of the uint16 range are stored as invalid, the users handle them as not existing scans
+	distance1[i] = static_cast<float>(info1.distance);
+	bscan1   [i] = toIndex(info1.bscan);
+	ascan1   [i] = toIndex(info1.ascan);
+	distance2[i] = static_cast<float>(info2.distance);
+	bscan2   [i] = toIndex(info2.bscan);
+	ascan2   [i] = toIndex(info2.ascan);
+
+	initMask[i >> 3] = static_cast<uint8_t>(initMask[i >> 3] | (1 << (i & 7)));
+}
+
+std::size_t SloBScanDistanceMap::PreCalcDataMatrix::memoryUsage() const
+{
+	return initMask.size()*sizeof(uint8_t)
+	     + (distance1.size() + distance2.size())*sizeof(float)
+	     + (bscan1.size() + ascan1.size() + bscan2.size() + ascan2.size())*sizeof(IndexType);
+}
+
+
 SloBScanDistanceMap::SloBScanDistanceMap()
 {
 }
@@ -571,14 +715,14 @@ SloBScanDistanceMap::~SloBScanDistanceMap()
 }
 
 
-void SloBScanDistanceMap::createData(const OctData::Series* series)
+bool SloBScanDistanceMap::createData(const OctData::Series* series, CppFW::Callback* callback)
 {
 	if(!series)
-		return;
+		return true;
 
 	const cv::Mat& sloImageMat = series->getSloImage().getImage();
 	if(sloImageMat.empty())
-		return;
+		return true;
 
 
 	PreCalcDataMatrix* oldPreCalcDataMatrix = preCalcDataMatrix;
@@ -589,6 +733,15 @@ void SloBScanDistanceMap::createData(const OctData::Series* series)
 	if(oldPreCalcDataMatrix)
 		delete oldPreCalcDataMatrix;
 
-	FillPreCalcData fpcd(*preCalcDataMatrix, *series);
+	timings = Timings();
+	FillPreCalcData fpcd(*preCalcDataMatrix, *series, timings, callback);
+
+	if(!fpcd.success())
+	{
+		delete preCalcDataMatrix;
+		preCalcDataMatrix = nullptr;
+		return false;
+	}
+	return true;
 }
 
@@ -19,14 +19,15 @@
 #ifndef SLOBSCANDISTANCEMAP_H
 #define SLOBSCANDISTANCEMAP_H
 
-#include<data_structure/matrx.h>
 #include<limits>
 #include<vector>
+#include<cstdint>
 
 #include "point2d.h"
 
 
 namespace OctData { class Series; }
+namespace CppFW { class Callback; }
 
 /**
  * @ingroup DataStructure
@@ -35,6 +36,7 @@ namespace OctData { class Series; }
  */
 class SloBScanDistanceMap
 {
+	friend class SloBScanDistanceMapCache;
 public:
 	class InfoBScanDist
 	{
@@ -51,19 +53,107 @@ public:
 		bool init = false;
 	};
 
-	typedef Matrix<PixelInfo> PreCalcDataMatrix;
+	/**
+	 * @brief Packed structure of arrays storage for the pixel informations
+	 *
+	 * B-scan and A-scan numbers are stored as uint16, the distances as float, the init flags in a bitmask.
+	 * The pixels are addressed by the linear index x + y*sizeX, the accessors for the single fields are cheap.
+	 * The bitmask is byte based, so pixel ranges starting at a multiple of 8 can be written in parallel.
+	 */
+	class PreCalcDataMatrix
+	{
+	public:
+		typedef uint16_t IndexType;
+		constexpr static const IndexType invalidIndex = std::numeric_limits<IndexType>::max();
+
+		PreCalcDataMatrix(std::size_t sizeX, std::size_t sizeY);
+
+		std::size_t getSizeX()                                const { return sizeX; }
+		std::size_t getSizeY()                                const { return sizeY; }
+		std::size_t index(std::size_t x, std::size_t y)       const { return x + y*sizeX; }
+
+		bool        isInit     (std::size_t i)                const { return (initMask[i >> 3] >> (i & 7)) & 1; }
+		float       getDistance1(std::size_t i)               const { return distance1[i]; }
+		float       getDistance2(std::size_t i)               const { return distance2[i]; }
+		std::size_t getBScan1  (std::size_t i)                const { return toSize(bscan1[i]); }
+		std::size_t getAScan1  (std::size_t i)                const { return toSize(ascan1[i]); }
+		std::size_t getBScan2  (std::size_t i)                const { return toSize(bscan2[i]); }
+		std::size_t getAScan2  (std::size_t i)                const { return toSize(ascan2[i]); }
+
+		/// raw access to the distance arrays for row wise loops
+		const float* getDistance1Data()                       const { return distance1.data(); }
+		const float* getDistance2Data()                       const { return distance2.data(); }
+
+		PixelInfo operator()(std::size_t x, std::size_t y)    const;
+		void setPixel(std::size_t i, const InfoBScanDist& info1, const InfoBScanDist& info2);
+
+		std::size_t memoryUsage()                             const;
+
+		/// call fun for each storage array (std::vector), used for the binary serialization
+		template<typename Fun> void forEachArray(Fun fun)         { forEachArrayPrivate(*this, fun); }
+		template<typename Fun> void forEachArray(Fun fun)   const { forEachArrayPrivate(*this, fun); }
+
+	private:
+
+		std::size_t sizeX;
+		std::size_t sizeY;
+
+		std::vector<uint8_t>   initMask;
+		std::vector<float>     distance1;
+		std::vector<float>     distance2;
+		std::vector<IndexType> bscan1;
+		std::vector<IndexType> ascan1;
+		std::vector<IndexType> bscan2;
+		std::vector<IndexType> ascan2;
+
+		template<typename Matrix, typename Fun>
+		static void forEachArrayPrivate(Matrix& m, Fun& fun)
+		{
+			fun(m.initMask );
+			fun(m.distance1);
+			fun(m.distance2);
+			fun(m.bscan1   );
+			fun(m.ascan1   );
+			fun(m.bscan2   );
+			fun(m.ascan2   );
+		}
+
+		static std::size_t toSize(IndexType v)                      { return v == invalidIndex ? std::numeric_limits<std::size_t>::max() : v; }
+		static IndexType   toIndex(std::size_t v)                   { return v < invalidIndex ? static_cast<IndexType>(v) : invalidIndex; }
+	};
+
+	/// duration of the calculation phases from the last createData call in milliseconds
+	class Timings
+	{
+	public:
+		double convexBroder  = 0;
+		double bscanBroder   = 0;
+		double l1DistanceMap = 0;
+		double l2Refinement  = 0;
+
+		double total() const { return convexBroder + bscanBroder + l1DistanceMap + l2Refinement; }
+	};
 
 
 	SloBScanDistanceMap();
 	~SloBScanDistanceMap();
 
-	void createData(const OctData::Series* series);
+	/**
+	 * @brief calculate the distance map for the series
+	 * @param callback optional progress callback, the calculation is aborted when it returns false
+	 * @return false, when the calculation was aborted (no data matrix is available in this case)
+	 */
+	bool createData(const OctData::Series* series, CppFW::Callback* callback = nullptr);
 
 
 	const PreCalcDataMatrix* getDataMatrix() const { return preCalcDataMatrix; }
+	const Timings&           getTimings()    const { return timings; }
 
 private:
 	PreCalcDataMatrix* preCalcDataMatrix = nullptr;
+	Timings            timings;
+
+	void setDataMatrix(PreCalcDataMatrix* matrix)                  { delete preCalcDataMatrix; preCalcDataMatrix = matrix; timings = Timings(); }
 
 };
 
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "slobscandistancemapcache.h"
+
+#include<filesystem>
+#include<fstream>
+#include<vector>
+#include<limits>
+#include<cstring>
+#include<sstream>
+#include<iomanip>
+
+#include<boost/iostreams/device/mapped_file.hpp>
+
+#include<opencv2/opencv.hpp>
+
+#include<octdata/datastruct/series.h>
+#include<octdata/datastruct/bscan.h>
+#include<octdata/datastruct/sloimage.h>
+
+#include<helper/slocoordtranslator.h>
+
+#include "slobscandistancemap.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	namespace Constants
+	{
+		const char     magic[8]     = {'O', 'C', 'T', 'D', 'M', 'A', 'P', '\0'};
+		const uint32_t version      = 2;
+		const uint32_t byteOrder    = 0x01020304;
+		const char*    extension    = ".slodistmap";
+	}
+
+	struct FileHeader
+	{
+		char     magic[8];
+		uint32_t version;
+		uint32_t byteOrder;
+		uint64_t geometryHash;
+		uint64_t sizeX;
+		uint64_t sizeY;
+		uint64_t dataSize;
+	};
+
+	/// FNV-1a 64 bit
+	class GeometryHash
+	{
+		uint64_t hash = 14695981039346656037ull;
+	public:
+		void add(const void* data, std::size_t size)
+		{
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			for(std::size_t i = 0; i < size; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+		}
+
+		template<typename T>
+		void add(const T& value)                                    { add(&value, sizeof(T)); }
+
+		void add(const OctData::CoordSLOpx& coord)                  { add(coord.getXf()); add(coord.getYf()); }
+
+		uint64_t get() const                                        { return hash; }
+	};
+
+	template<typename T>
+	std::size_t arrayBytes(const std::vector<T>& vec)               { return vec.size()*sizeof(T); }
+}
+
+
+SloBScanDistanceMapCache::SloBScanDistanceMapCache(const std::string& cacheDir)
+: cacheDir(cacheDir)
+{
+}
+
+
+uint64_t SloBScanDistanceMapCache::geometryHash(const OctData::Series& series)
+{
+	GeometryHash hash;
+	hash.add(Constants::version);
+
+	const cv::Mat& sloImageMat = series.getSloImage().getImage();
+	hash.add(sloImageMat.cols);
+	hash.add(sloImageMat.rows);
+
+	// the pixel coordinates contains the transformation from the SLO coordinates
+	const SloCoordTranslator transformCoord(series);
+
+	hash.add(series.getConvexHull().size());
+	for(const OctData::CoordSLOmm& point : series.getConvexHull())
+		hash.add(transformCoord(point));
+
+	hash.add(series.bscanCount());
+	for(const std::shared_ptr<const OctData::BScan>& bscan : series.getBScans())
+	{
+		if(!bscan)
+		{
+			hash.add(false);
+			continue;
+		}
+
+		hash.add(true);
+		hash.add(bscan->getBScanType());
+		hash.add(bscan->getWidth());
+		hash.add(bscan->getClockwiseRot());
+		hash.add(transformCoord(bscan->getStart ()));
+		hash.add(transformCoord(bscan->getEnd   ()));
+		hash.add(transformCoord(bscan->getCenter()));
+	}
+
+	return hash.get();
+}
+
+
+std::string SloBScanDistanceMapCache::getCacheFilename(uint64_t hash) const
+{
+	std::ostringstream filename;
+	filename << std::hex << std::setw(16) << std::setfill('0') << hash << Constants::extension;
+	return (fs::path(cacheDir) / filename.str()).string();
+}
+
+
+bool SloBScanDistanceMapCache::load(SloBScanDistanceMap& map, const OctData::Series& series) const
+{
+	const uint64_t hash = geometryHash(series);
+	const std::string filename = getCacheFilename(hash);
+
+	std::error_code ec;
+	if(!fs::is_regular_file(filename, ec))
+		return false;
+
+	try
+	{
+		boost::iostreams::mapped_file_source file(filename);
+		if(!file.is_open() || file.size() < sizeof(FileHeader))
+			return false;
+
+		const char* data = file.data();
+
+		FileHeader header;
+		std::memcpy(&header, data, sizeof(FileHeader));
+
+		const cv::Mat& sloImageMat = series.getSloImage().getImage();
+
+		if(std::memcmp(header.magic, Constants::magic, sizeof(Constants::magic)) != 0
+		|| header.version      != Constants::version
+		|| header.byteOrder    != Constants::byteOrder
+		|| header.geometryHash != hash
+		|| header.sizeX        != static_cast<uint64_t>(sloImageMat.cols)
+		|| header.sizeY        != static_cast<uint64_t>(sloImageMat.rows))
+			return false;
+
+		SloBScanDistanceMap::PreCalcDataMatrix* matrix = new SloBScanDistanceMap::PreCalcDataMatrix(static_cast<std::size_t>(header.sizeX), static_cast<std::size_t>(header.sizeY));
+
+		std::size_t dataSize = 0;
+		matrix->forEachArray([&dataSize](const auto& vec) { dataSize += arrayBytes(vec); });
+
+		if(header.dataSize != dataSize || file.size() != sizeof(FileHeader) + dataSize)
+		{
+			delete matrix;
+			return false;
+		}
+
+		const char* pos = data + sizeof(FileHeader);
+		matrix->forEachArray([&pos](auto& vec)
+		{
+			std::memcpy(vec.data(), pos, arrayBytes(vec));
+			pos += arrayBytes(vec);
+		});
+
+		map.setDataMatrix(matrix);
+	}
+	catch(std::exception&)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+bool SloBScanDistanceMapCache::save(const SloBScanDistanceMap& map, const OctData::Series& series) const
+{
+	const SloBScanDistanceMap::PreCalcDataMatrix* matrix = map.getDataMatrix();
+	if(!matrix)
+		return false;
+
+	FileHeader header;
+	std::memcpy(header.magic, Constants::magic, sizeof(Constants::magic));
+	header.version       = Constants::version;
+	header.byteOrder     = Constants::byteOrder;
+	header.geometryHash  = geometryHash(series);
+	header.sizeX         = matrix->getSizeX();
+	header.sizeY         = matrix->getSizeY();
+	header.dataSize      = 0;
+	matrix->forEachArray([&header](const auto& vec) { header.dataSize += arrayBytes(vec); });
+
+	const std::string filename = getCacheFilename(header.geometryHash);
+	const std::string tmpFilename = filename + ".tmp";
+
+	std::error_code ec;
+	fs::create_directories(cacheDir, ec);
+	if(ec)
+		return false;
+
+	{
+		std::ofstream stream(tmpFilename, std::ios::binary | std::ios::trunc);
+		if(!stream)
+			return false;
+
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+		matrix->forEachArray([&stream](const auto& vec)
+		{
+			stream.write(reinterpret_cast<const char*>(vec.data()), static_cast<std::streamsize>(arrayBytes(vec)));
+		});
+		if(!stream)
+		{
+			stream.close();
+			fs::remove(tmpFilename, ec);
+			return false;
+		}
+	}
+
+	fs::rename(tmpFilename, filename, ec);
+	if(ec)
+	{
+		fs::remove(tmpFilename, ec);
+		return false;
+	}
+	return true;
+}
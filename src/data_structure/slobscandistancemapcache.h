@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include<string>
+#include<cstdint>
+
+class SloBScanDistanceMap;
+
+namespace OctData { class Series; }
+
+/**
+ * @ingroup DataStructure
+ * @brief Persistent binary cache for SloBScanDistanceMap
+ *
+ * The distance map depends only on the geometry of the series (SLO size, b-scan positions and convex hull).
+ * A hash of this geometry is the name of the cache file, the header of the file is validated on load.
+ */
+class SloBScanDistanceMapCache
+{
+public:
+	explicit SloBScanDistanceMapCache(const std::string& cacheDir);
+
+	/// load the map from cache, return false if no valid cache file exists
+	bool load(SloBScanDistanceMap& map, const OctData::Series& series) const;
+	/// write the map to cache (atomic replace of the cache file)
+	bool save(const SloBScanDistanceMap& map, const OctData::Series& series) const;
+
+	static uint64_t geometryHash(const OctData::Series& series);
+
+private:
+	std::string cacheDir;
+
+	std::string getCacheFilename(uint64_t hash) const;
+};
@@ -7,5 +7,5 @@
  * @brief List of supported OCT-Marker save file formats
  *
  */
-enum class OctMarkerFileformat { Unknown, NoExtension, Auto, XML, Json, INFO };
+enum class OctMarkerFileformat { Unknown, NoExtension, Auto, XML, Json, INFO, Binary };
 
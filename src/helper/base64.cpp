@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "base64.h"
+
+#include<cstdint>
+
+namespace
+{
+	const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	// 0-63 for the characters of the alphabet, 64 for all other
+	struct DecodeTable
+	{
+		uint8_t values[256];
+		DecodeTable()
+		{
+			for(uint8_t& v : values)
+				v = 64;
+			for(uint8_t i = 0; i < 64; ++i)
+				values[static_cast<unsigned char>(alphabet[i])] = i;
+		}
+	};
+	const DecodeTable decodeTable;
+}
+
+namespace Base64
+{
+	void encode(const char* data, std::size_t size, std::string& text)
+	{
+		text.resize((size + 2)/3*4);
+		const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+		char* out = &text[0];
+
+		std::size_t pos = 0;
+		for(; pos + 3 <= size; pos += 3)
+		{
+			const uint32_t triple = static_cast<uint32_t>(in[pos] << 16 | in[pos+1] << 8 | in[pos+2]);
+			*out++ = alphabet[(triple >> 18) & 0x3F];
+			*out++ = alphabet[(triple >> 12) & 0x3F];
+			*out++ = alphabet[(triple >>  6) & 0x3F];
+			*out++ = alphabet[ triple        & 0x3F];
+		}
+
+		const std::size_t rest = size - pos;
+		if(rest > 0)
+		{
+			const uint32_t triple = static_cast<uint32_t>(in[pos] << 16 | (rest == 2 ? in[pos+1] << 8 : 0));
+			*out++ = alphabet[(triple >> 18) & 0x3F];
+			*out++ = alphabet[(triple >> 12) & 0x3F];
+			*out++ = rest == 2 ? alphabet[(triple >> 6) & 0x3F] : '=';
+			*out++ = '=';
+		}
+	}
+
+	bool decode(const char* text, std::size_t length, std::string& data)
+	{
+		if(length%4 != 0)
+			return false;
+
+		std::size_t padding = 0;
+		if(length > 0 && text[length-1] == '=')
+			padding = (text[length-2] == '=') ? 2 : 1;
+
+		data.resize(length/4*3 - padding);
+		char* out = &data[0];
+		const std::size_t fullBlocks = (padding > 0) ? length/4 - 1 : length/4;
+
+		const unsigned char* in = reinterpret_cast<const unsigned char*>(text);
+		for(std::size_t block = 0; block < fullBlocks; ++block, in += 4)
+		{
+			const uint8_t v0 = decodeTable.values[in[0]];
+			const uint8_t v1 = decodeTable.values[in[1]];
+			const uint8_t v2 = decodeTable.values[in[2]];
+			const uint8_t v3 = decodeTable.values[in[3]];
+			if((v0 | v1 | v2 | v3) & 64)
+				return false;
+
+			const uint32_t triple = static_cast<uint32_t>(v0 << 18 | v1 << 12 | v2 << 6 | v3);
+			*out++ = static_cast<char>(triple >> 16);
+			*out++ = static_cast<char>(triple >>  8);
+			*out++ = static_cast<char>(triple      );
+		}
+
+		if(padding > 0)
+		{
+			const uint8_t v0 = decodeTable.values[in[0]];
+			const uint8_t v1 = decodeTable.values[in[1]];
+			const uint8_t v2 = (padding == 1) ? decodeTable.values[in[2]] : 0;
+			if((v0 | v1 | v2) & 64)
+				return false;
+
+			// canonical form: the unused bits are zero
+			const uint32_t triple = static_cast<uint32_t>(v0 << 18 | v1 << 12 | v2 << 6);
+			if(padding == 2 && (triple & 0xFFFF) != 0)
+				return false;
+			if(padding == 1 && (triple & 0xFF) != 0)
+				return false;
+
+			*out++ = static_cast<char>(triple >> 16);
+			if(padding == 1)
+				*out++ = static_cast<char>(triple >> 8);
+		}
+		return true;
+	}
+}
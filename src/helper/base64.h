@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BASE64_H
+#define BASE64_H
+
+#include<string>
+#include<cstddef>
+
+/**
+ * @ingroup HelperClasses
+ * @brief Base64 encoding (RFC 4648, with padding)
+ *
+ * decode only accepts the canonical form (the output of encode), so decode followed
+ * by encode always restores the input text.
+ */
+namespace Base64
+{
+	void encode(const char* data, std::size_t size, std::string& text);
+	bool decode(const char* text, std::size_t length, std::string& data);
+}
+
+#endif // BASE64_H
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "overlayblend.h"
+
+#include<cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define OVERLAYBLEND_SSE2
+	#include<emmintrin.h>
+#endif
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+	#define OVERLAYBLEND_SSSE3
+	#include<tmmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+	#define OVERLAYBLEND_AVX2
+	#include<immintrin.h>
+#endif
+
+
+namespace
+{
+	/**
+	 * fixed-point factor for the overlay weight w = (a*factor) >> 9 with 0 <= w <= 256,
+	 * w is the weight of the overlay pixel in 1/256 steps
+	 */
+	uint16_t calcAlphaFactor(double alpha)
+	{
+		if(!(alpha > 0))
+			return 0;
+		if(alpha > 1)
+			alpha = 1;
+		return static_cast<uint16_t>(alpha*131072./255. + 0.5) + 1;
+	}
+
+	inline uint8_t blendChannel(uint32_t src, uint32_t overlay, uint32_t weight)
+	{
+		return static_cast<uint8_t>((src*(256 - weight) + overlay*weight + 128) >> 8);
+	}
+
+	template<int channels>
+	void blendScalar(const uint8_t* src, const uint8_t* overlay, uint8_t* dest, std::size_t numPixels, uint32_t alphaFactor)
+	{
+		for(std::size_t i = 0; i < numPixels; ++i)
+		{
+			const uint32_t weight = (overlay[3]*alphaFactor) >> 9;
+			if(channels == 1)
+			{
+				dest[0] = blendChannel(src[0], overlay[0], weight);
+				dest[1] = blendChannel(src[0], overlay[1], weight);
+				dest[2] = blendChannel(src[0], overlay[2], weight);
+			}
+			else
+			{
+				dest[0] = blendChannel(src[0], overlay[0], weight);
+				dest[1] = blendChannel(src[1], overlay[1], weight);
+				dest[2] = blendChannel(src[2], overlay[2], weight);
+			}
+
+			overlay += 4;
+			dest    += 3;
+			src     += channels;
+		}
+	}
+
+
+#ifdef OVERLAYBLEND_SSE2
+	// 2 pixels as 16 bit values (b, g, r, a, b, g, r, a)
+	inline __m128i blendPixels16(__m128i src, __m128i overlay, __m128i alphaFactor)
+	{
+		__m128i weight = _mm_mulhi_epu16(_mm_slli_epi16(overlay, 7), alphaFactor);
+		weight = _mm_shufflelo_epi16(weight, _MM_SHUFFLE(3, 3, 3, 3));
+		weight = _mm_shufflehi_epi16(weight, _MM_SHUFFLE(3, 3, 3, 3));
+
+		const __m128i srcWeight = _mm_sub_epi16(_mm_set1_epi16(256), weight);
+		const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(src, srcWeight), _mm_mullo_epi16(overlay, weight));
+		return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+	}
+
+	// 4 pixels, src as BGRx and overlay as BGRA, result as BGRx
+	inline __m128i blendPixels(__m128i src, __m128i overlay, __m128i alphaFactor)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i lo = blendPixels16(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(overlay, zero), alphaFactor);
+		const __m128i hi = blendPixels16(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(overlay, zero), alphaFactor);
+		return _mm_packus_epi16(lo, hi);
+	}
+
+	// load 4 source pixels as BGRx, for 3 channels 16 bytes are read
+	// without SSSE3 there is no byte shuffle and the scalar loop is faster for 3 channels
+	template<int channels>
+	inline __m128i loadSrcPixels(const uint8_t* src);
+
+	template<>
+	inline __m128i loadSrcPixels<1>(const uint8_t* src)
+	{
+		int32_t gray;
+		std::memcpy(&gray, src, sizeof(gray));
+		__m128i pixels = _mm_cvtsi32_si128(gray);
+		pixels = _mm_unpacklo_epi8 (pixels, pixels);
+		return   _mm_unpacklo_epi16(pixels, pixels);
+	}
+
+#ifdef OVERLAYBLEND_SSSE3
+	template<>
+	inline __m128i loadSrcPixels<3>(const uint8_t* src)
+	{
+		const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)), expand);
+	}
+#endif
+
+	// store 4 BGRx pixels as BGR, up to 16 bytes are written
+	inline void storeDestPixels(uint8_t* dest, __m128i pixels)
+	{
+#ifdef OVERLAYBLEND_SSSE3
+		const __m128i compress = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_shuffle_epi8(pixels, compress));
+#else
+		// overlapping 4 byte stores, the unused channel is overwritten by the next pixel
+		for(int i = 0; i < 4; ++i)
+		{
+			const int32_t pixel = _mm_cvtsi128_si32(pixels);
+			std::memcpy(dest + i*3, &pixel, sizeof(pixel));
+			pixels = _mm_srli_si128(pixels, 4);
+		}
+#endif
+	}
+#endif
+
+
+#ifdef OVERLAYBLEND_AVX2
+	// 8 pixels, in each 128 bit lane 2 pixels as 16 bit values
+	inline __m256i blendPixels16(__m256i src, __m256i overlay, __m256i alphaFactor)
+	{
+		__m256i weight = _mm256_mulhi_epu16(_mm256_slli_epi16(overlay, 7), alphaFactor);
+		weight = _mm256_shufflelo_epi16(weight, _MM_SHUFFLE(3, 3, 3, 3));
+		weight = _mm256_shufflehi_epi16(weight, _MM_SHUFFLE(3, 3, 3, 3));
+
+		const __m256i srcWeight = _mm256_sub_epi16(_mm256_set1_epi16(256), weight);
+		const __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(src, srcWeight), _mm256_mullo_epi16(overlay, weight));
+		return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(128)), 8);
+	}
+
+	inline __m256i blendPixels(__m256i src, __m256i overlay, __m256i alphaFactor)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i lo = blendPixels16(_mm256_unpacklo_epi8(src, zero), _mm256_unpacklo_epi8(overlay, zero), alphaFactor);
+		const __m256i hi = blendPixels16(_mm256_unpackhi_epi8(src, zero), _mm256_unpackhi_epi8(overlay, zero), alphaFactor);
+		return _mm256_packus_epi16(lo, hi);
+	}
+#endif
+
+
+	template<int channels>
+	void blend(const uint8_t* src, const uint8_t* overlay, uint8_t* dest, std::size_t numPixels, double alpha)
+	{
+		const uint16_t alphaFactor = calcAlphaFactor(alpha);
+
+		// the vector loops read and write up to 4 bytes behind the last processed pixel,
+		// the scalar loop handles the last pixels
+		std::size_t i = 0;
+
+#ifdef OVERLAYBLEND_AVX2
+		const __m256i alphaFactor256 = _mm256_set1_epi16(static_cast<short>(alphaFactor));
+		for(; i + 12 <= numPixels; i += 8)
+		{
+			const __m256i srcPixels = _mm256_setr_m128i(loadSrcPixels<channels>(src + i*channels), loadSrcPixels<channels>(src + (i+4)*channels));
+			const __m256i overlayPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(overlay + i*4));
+			const __m256i result = blendPixels(srcPixels, overlayPixels, alphaFactor256);
+
+			storeDestPixels(dest +  i   *3, _mm256_castsi256_si128  (result   ));
+			storeDestPixels(dest + (i+4)*3, _mm256_extracti128_si256(result, 1));
+		}
+#endif
+
+#ifdef OVERLAYBLEND_SSE2
+	#ifdef OVERLAYBLEND_SSSE3
+		constexpr const bool useSSE2 = true;
+	#else
+		constexpr const bool useSSE2 = channels == 1;
+	#endif
+		if constexpr(useSSE2)
+		{
+			const __m128i alphaFactor128 = _mm_set1_epi16(static_cast<short>(alphaFactor));
+			for(; i + 8 <= numPixels; i += 4)
+			{
+				const __m128i srcPixels = loadSrcPixels<channels>(src + i*channels);
+				const __m128i overlayPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(overlay + i*4));
+				storeDestPixels(dest + i*3, blendPixels(srcPixels, overlayPixels, alphaFactor128));
+			}
+		}
+#endif
+
+		blendScalar<channels>(src + i*channels, overlay + i*4, dest + i*3, numPixels - i, alphaFactor);
+	}
+}
+
+
+bool OverlayBlend::blendBGRA(const uint8_t* src, int srcChannels, const uint8_t* overlay, uint8_t* dest, std::size_t numPixels, double alpha)
+{
+	switch(srcChannels)
+	{
+		case 1:
+			blend<1>(src, overlay, dest, numPixels, alpha);
+			return true;
+		case 3:
+			blend<3>(src, overlay, dest, numPixels, alpha);
+			return true;
+		default:
+			return false;
+	}
+}
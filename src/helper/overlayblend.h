@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef OVERLAYBLEND_H
+#define OVERLAYBLEND_H
+
+#include<cstddef>
+#include<cstdint>
+
+/**
+ * @ingroup HelperClasses
+ * @brief Blend a BGRA overlay on a gray or BGR image, the result is a BGR image
+ *
+ * The weight of an overlay pixel is its alpha channel multiplied with alpha (0 - 1),
+ * the blending is done in 8 bit fixed-point arithmetic. Depending on the compile flags
+ * an AVX2 or SSE2 kernel is used, with a scalar loop for the remaining pixels.
+ *
+ * @return false for an unsupported number of source channels (only 1 and 3 are supported)
+ */
+namespace OverlayBlend
+{
+	bool blendBGRA(const uint8_t* src, int srcChannels, const uint8_t* overlay, uint8_t* dest, std::size_t numPixels, double alpha);
+}
+
+#endif // OVERLAYBLEND_H
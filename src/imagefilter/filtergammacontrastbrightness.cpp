@@ -40,6 +40,8 @@ void FilterGammaContrastBrightness::applyFilter(const cv::Mat& in, cv::Mat& out)
 	const uint8_t* dataIn  = in .ptr<uint8_t>();
 	      uint8_t* dataOut = out.ptr<uint8_t>();
 
+	std::lock_guard<std::mutex> lock(lutMutex);
+
 	for(int i = 0; i < in.rows*in.cols*in.channels(); ++i)
 	{
 		*dataOut = lut[*dataIn];
@@ -55,11 +57,13 @@ void FilterGammaContrastBrightness::calcLut()
 	const double contrast   = parameter.contrast  ;
 	const double brightness = parameter.brightness;
 
+	std::unique_lock<std::mutex> lock(lutMutex);
 	for(int i = 0; i < static_cast<int>(sizeof(lut)/sizeof(lut[0])); ++i)
 	{
 		const double gammaValue = std::pow((i / 255.0), gamma);
 		lut[i] = cv::saturate_cast<uchar>((gammaValue*contrast + brightness)*255.0);
 	}
+	lock.unlock();
 
 	parameterChanged();
 }
@@ -22,6 +22,7 @@
 #include "filterimage.h"
 
 #include <cstdint>
+#include <mutex>
 
 /**
  * @ingroup ImageFilter
@@ -55,6 +56,7 @@ private:
 
 	Parameter parameter;
 
+	mutable std::mutex lutMutex;
 	unsigned char lut[256];
 };
 
@@ -26,6 +26,7 @@ namespace cv { class Mat; }
  * @ingroup ImageFilter
  * @brief Interface class for the image filter
  *
+ * applyFilter is also called from the B-scan prefetch thread, implementations have to be thread safe.
  */
 class FilterImage : public QObject
 {
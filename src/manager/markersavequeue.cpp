@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "markersavequeue.h"
+
+#include<algorithm>
+#include<iostream>
+
+#include <boost/exception/diagnostic_information.hpp>
+
+
+MarkerSaveQueue::MarkerSaveQueue()
+{
+	worker = std::thread(&MarkerSaveQueue::run, this);
+}
+
+MarkerSaveQueue::~MarkerSaveQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	jobCondition.notify_all();
+	worker.join();
+
+	if(error)
+	{
+		try
+		{
+			std::rethrow_exception(error);
+		}
+		catch(...)
+		{
+			std::cerr << "MarkerSaveQueue: error on saving markers: " << boost::current_exception_diagnostic_information() << std::endl;
+		}
+	}
+}
+
+
+void MarkerSaveQueue::enqueue(OctMarkerIO::SaveSnapshot snapshot)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::deque<OctMarkerIO::SaveSnapshot>::iterator it = std::find_if(jobs.begin(), jobs.end(), [&snapshot](const OctMarkerIO::SaveSnapshot& job) { return job.filename == snapshot.filename; });
+		if(it != jobs.end())
+			*it = std::move(snapshot);
+		else
+			jobs.push_back(std::move(snapshot));
+	}
+	jobCondition.notify_one();
+}
+
+void MarkerSaveQueue::waitFinished()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idleCondition.wait(lock, [this] { return jobs.empty() && !working; });
+
+	std::exception_ptr lastError;
+	std::swap(lastError, error);
+	lock.unlock();
+
+	if(lastError)
+		std::rethrow_exception(lastError);
+}
+
+
+void MarkerSaveQueue::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for(;;)
+	{
+		jobCondition.wait(lock, [this] { return stop || !jobs.empty(); });
+		if(jobs.empty()) // stop only after all snapshots are written
+			return;
+
+		const OctMarkerIO::SaveSnapshot snapshot = std::move(jobs.front());
+		jobs.pop_front();
+		working = true;
+		lock.unlock();
+
+		std::exception_ptr writeError;
+		try
+		{
+			OctMarkerIO::writeSnapshot(snapshot);
+		}
+		catch(...)
+		{
+			writeError = std::current_exception();
+		}
+
+		lock.lock();
+		working = false;
+		if(writeError && !error)
+			error = writeError;
+		idleCondition.notify_all();
+	}
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MARKERSAVEQUEUE_H
+#define MARKERSAVEQUEUE_H
+
+#include<deque>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<exception>
+
+#include "octmarkerio.h"
+
+/**
+ * @ingroup Manager
+ * @brief writes marker snapshots in a worker thread
+ *
+ * A snapshot for a file which is still waiting in the queue replaces the older one.
+ * The destructor writes all pending snapshots before it returns.
+ */
+class MarkerSaveQueue
+{
+public:
+	MarkerSaveQueue();
+	~MarkerSaveQueue();
+
+	MarkerSaveQueue(const MarkerSaveQueue&) = delete;
+	MarkerSaveQueue& operator=(const MarkerSaveQueue&) = delete;
+
+	void enqueue(OctMarkerIO::SaveSnapshot snapshot);
+
+	/// blocks until all snapshots are written, rethrows the first error since the last call
+	void waitFinished();
+
+private:
+	std::deque<OctMarkerIO::SaveSnapshot> jobs;
+	std::exception_ptr                    error;
+
+	bool working = false;
+	bool stop    = false;
+
+	std::mutex              mutex;
+	std::condition_variable jobCondition;
+	std::condition_variable idleCondition;
+	std::thread             worker;
+
+	void run();
+};
+
+#endif // MARKERSAVEQUEUE_H
@@ -33,6 +33,7 @@
 #include<QApplication>
 #include<QFileInfo>
 #include<QDir>
+#include<QStandardPaths>
 
 #include <octdata/datastruct/series.h>
 #include <octdata/datastruct/bscan.h>
@@ -44,43 +45,108 @@
 #include <helper/ptreehelper.h>
 #include <data_structure/programoptions.h>
 #include <data_structure/slobscandistancemap.h>
+#include <data_structure/slobscandistancemapcache.h>
 
 #include "octmarkerio.h"
+#include "markersavequeue.h"
 #include "octmarkermanager.h"
 
 namespace bpt = boost::property_tree;
 namespace bfs = std::filesystem;
 
+namespace
+{
+	/// calls function, returns the text of an exception thrown by function or an empty string
+	template<typename Function>
+	QString callAndGetErrorText(Function&& function)
+	{
+		try
+		{
+			function();
+		}
+		catch(boost::exception& e)
+		{
+			return QString::fromStdString(boost::diagnostic_information(e));
+		}
+		catch(std::exception& e)
+		{
+			return QString::fromStdString(e.what());
+		}
+		catch(const char* str)
+		{
+			return str;
+		}
+		catch(...)
+		{
+			return QString("Unknow error in file %1 line %2").arg(__FILE__).arg(__LINE__);
+		}
+		return QString();
+	}
+
+	void showErrorMessage(const QString& text)
+	{
+		QMessageBox msgBox;
+		msgBox.setText(text);
+		msgBox.setIcon(QMessageBox::Critical);
+		msgBox.exec();
+	}
+}
 
 
 OctDataManager::OctDataManager()
 : markerstree(std::make_unique<bpt::ptree>())
 , markerIO(std::make_unique<OctMarkerIO>(markerstree.get()))
+, saveQueue(std::make_unique<MarkerSaveQueue>())
 {
 	connect(this, &OctDataManager::seriesChanged, this, &OctDataManager::clearSeriesCache);
+	markerIO->setLazySeriesLoading(true);
 }
 
 
 
-OctDataManager::~OctDataManager() = default;
+OctDataManager::~OctDataManager()
+{
+	abortDistanceMapThread();
+}
 
 
 void OctDataManager::saveMarkersDefault()
 {
-	if(ProgramOptions::autoSaveOctMarkers())
-		triggerSaveMarkersDefault();
+	// autosave doesn't wait for the write, errors are reported by the next waitForMarkerSaves
+	// without changes the file isn't written, so the not yet used series of a lazy loaded file are not read
+	if(!ProgramOptions::autoSaveOctMarkers() || !OctMarkerManager::getInstance().hasChangedSinceLastSave())
+		return;
+
+	if(enqueueSaveMarkersDefault())
+		OctMarkerManager::getInstance().resetChangedSinceLastSaveState();
 }
 
 void OctDataManager::triggerSaveMarkersDefault()
 {
-	if(!actFilename.isEmpty())
+	if(enqueueSaveMarkersDefault())
 	{
-		saveMarkerState(actSeries);
-		markerIO->saveDefaultMarker(actFilename.toStdString());
+		waitForMarkerSaves(); // throws on write errors, the markers stay marked as changed
 		OctMarkerManager::getInstance().resetChangedSinceLastSaveState();
 	}
 }
 
+bool OctDataManager::enqueueSaveMarkersDefault()
+{
+	if(actFilename.isEmpty())
+		return false;
+
+	saveMarkerState(actSeries);
+	OctMarkerIO::SaveSnapshot snapshot;
+	if(markerIO->createDefaultMarkerSnapshot(actFilename.toStdString(), snapshot))
+		saveQueue->enqueue(std::move(snapshot));
+	return true;
+}
+
+void OctDataManager::waitForMarkerSaves()
+{
+	saveQueue->waitFinished();
+}
+
 
 void OctDataManagerThread::run()
 {
@@ -196,35 +262,17 @@ void OctDataManager::loadOctDataThreadFinish()
 		}
 		else
 		{
-			QString error;
-			try
-			{
-				markerstree->clear();
-				markerIO->loadDefaultMarker(loadThread->getFilename().toStdString());
-			}
-			catch(boost::exception& e)
-			{
-				error = QString::fromStdString(boost::diagnostic_information(e));
-			}
-			catch(std::exception& e)
-			{
-				error = QString::fromStdString(e.what());
-			}
-			catch(const char* str)
-			{
-				error = str;
-			}
-			catch(...)
-			{
-				error = QString("Unknow error in file %1 line %2").arg(__FILE__).arg(__LINE__);
-			}
-			if(!error.isEmpty())
-			{
-				QMessageBox msgBox;
-				msgBox.setText("OctDataManager::openFile: markerload failed: " + error);
-				msgBox.setIcon(QMessageBox::Critical);
-				msgBox.exec();
-			}
+			// the file could be the last saved one, an error belongs to the save of the previous file
+			const QString saveError = callAndGetErrorText([this]{ saveQueue->waitFinished(); });
+			if(!saveError.isEmpty())
+				showErrorMessage("OctDataManager::openFile: markersave failed: " + saveError);
+
+			markerstree->clear();
+			markerIO->dropDeferredSeries();
+
+			const QString loadError = callAndGetErrorText([this]{ markerIO->loadDefaultMarker(loadThread->getFilename().toStdString()); });
+			if(!loadError.isEmpty())
+				showErrorMessage("OctDataManager::openFile: markerload failed: " + loadError);
 
 			actFilename = loadThread->getFilename();
 
@@ -310,6 +358,11 @@ boost::property_tree::ptree* OctDataManager::getMarkerTreeSeries(const std::shar
 	bpt::ptree& studyNode  = PTreeHelper::getNodeWithId(patNode     , "Study"  , study  ->getInternalId());
 	bpt::ptree& seriesNode = PTreeHelper::getNodeWithId(studyNode   , "Series" , series ->getInternalId());
 
+	// a damaged section of a lazy loaded marker file is dropped, the series starts without these markers
+	const QString error = callAndGetErrorText([this, &seriesNode]{ markerIO->loadSeriesMarkers(seriesNode); });
+	if(!error.isEmpty())
+		showErrorMessage("OctDataManager::getMarkerTreeSeries: markerload failed: " + error);
+
 
 	PTreeHelper::putNotEmpty(patNode   , "PatientUID", patient->getPatientUID());
 	PTreeHelper::putNotEmpty(studyNode , "StudyUID"  , study  ->getStudyUID  ());
@@ -322,6 +375,7 @@ boost::property_tree::ptree* OctDataManager::getMarkerTreeSeries(const std::shar
 
 bool OctDataManager::loadMarkers(QString filename, OctMarkerFileformat format)
 {
+	waitForMarkerSaves();
 	markerstree->clear();
 	markerIO->loadMarkers(filename.toStdString(), format);
 	emit(loadMarkerStateAll());
@@ -331,6 +385,7 @@ bool OctDataManager::loadMarkers(QString filename, OctMarkerFileformat format)
 
 void OctDataManager::saveMarkers(QString filename, OctMarkerFileformat format)
 {
+	waitForMarkerSaves();
 	saveMarkerState(actSeries);
 	markerIO->saveMarkers(filename.toStdString(), format);
 	OctMarkerManager::getInstance().resetChangedSinceLastSaveState();
@@ -349,18 +404,74 @@ void OctDataManager::saveOctScan(QString filename)
 
 const SloBScanDistanceMap* OctDataManager::getSeriesSLODistanceMap() const
 {
-	if(!seriesSLODistanceMap)
-	{
-		seriesSLODistanceMap = std::make_unique<SloBScanDistanceMap>();
-		seriesSLODistanceMap->createData(actSeries.get());
-	}
-
 	return seriesSLODistanceMap.get();
 }
 
 void OctDataManager::clearSeriesCache()
 {
+	abortDistanceMapThread();
 	seriesSLODistanceMap.reset();
+
+	if(!actSeries)
+		return;
+
+	std::string cacheDir;
+	if(ProgramOptions::sloDistanceMapCache())
+	{
+		const QString cacheLocation = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+		if(!cacheLocation.isEmpty())
+			cacheDir = QDir(cacheLocation).filePath("slodistancemaps").toStdString();
+	}
+
+	distanceMapThread = std::make_unique<SloDistanceMapThread>(actSeries, cacheDir);
+	connect(distanceMapThread.get(), &SloDistanceMapThread::stepCalulated, this, &OctDataManager::distanceMapThreadProgress);
+	connect(distanceMapThread.get(), &SloDistanceMapThread::finished     , this, &OctDataManager::distanceMapThreadFinish  );
+	emit(seriesSLODistanceMapCalculation(true));
+	distanceMapThread->start();
+}
+
+void OctDataManager::abortDistanceMapThread()
+{
+	if(!distanceMapThread)
+		return;
+
+	distanceMapThread->disconnect(this);
+	distanceMapThread->breakCalc();
+	distanceMapThread->wait();
+	distanceMapThread.reset();
+	emit(seriesSLODistanceMapCalculation(false));
+}
+
+void OctDataManager::distanceMapThreadFinish()
+{
+	if(!distanceMapThread || sender() != distanceMapThread.get()) // finished signal from an aborted calculation
+		return;
+
+	std::unique_ptr<SloDistanceMapThread> thread = std::move(distanceMapThread);
+	thread->wait();
+	emit(seriesSLODistanceMapCalculation(false));
+
+	if(!thread->success() || thread->getSeries() != actSeries)
+		return;
+
+	seriesSLODistanceMap = thread->getDistanceMap();
+
+	if(thread->fromCache())
+		std::cout << "SLO distance map loaded from cache" << std::endl;
+	else
+	{
+		const SloBScanDistanceMap::Timings& timings = seriesSLODistanceMap->getTimings();
+		std::cout << "Creating SLO distance map took " << timings.total() << " milliseconds"
+		          << " (convex broder: " << timings.convexBroder
+		          << ", b-scan broder: " << timings.bscanBroder
+		          << ", L1 map: "        << timings.l1DistanceMap
+		          << ", L2 refinement: " << timings.l2Refinement << ")" << std::endl;
+	}
+
+	if(const SloBScanDistanceMap::PreCalcDataMatrix* matrix = seriesSLODistanceMap->getDataMatrix())
+		std::cout << "SLO distance map uses " << matrix->memoryUsage()/1024 << " KiB" << std::endl;
+
+	emit(seriesSLODistanceMapReady());
 }
 
 void OctDataManager::abortLoadingOctFile()
@@ -380,3 +491,42 @@ std::unique_ptr<OctData::OCT> OctDataManagerThread::getOctData()
 {
 	return std::move(octData);
 }
+
+
+SloDistanceMapThread::SloDistanceMapThread(const std::shared_ptr<const OctData::Series>& series, const std::string& cacheDir)
+: series(series)
+, cacheDir(cacheDir)
+{}
+
+SloDistanceMapThread::~SloDistanceMapThread() = default;
+
+void SloDistanceMapThread::run()
+{
+	distanceMap = std::make_unique<SloBScanDistanceMap>();
+
+	if(series && !cacheDir.empty())
+	{
+		SloBScanDistanceMapCache cache(cacheDir);
+		if(cache.load(*distanceMap, *series))
+		{
+			calcSuccess     = true;
+			loadedFromCache = true;
+			return;
+		}
+	}
+
+	calcSuccess = distanceMap->createData(series.get(), this);
+	if(!calcSuccess)
+	{
+		distanceMap.reset();
+		return;
+	}
+
+	if(series && !cacheDir.empty())
+		SloBScanDistanceMapCache(cacheDir).save(*distanceMap, *series);
+}
+
+std::unique_ptr<SloBScanDistanceMap> SloDistanceMapThread::getDistanceMap()
+{
+	return std::move(distanceMap);
+}
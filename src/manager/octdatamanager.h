@@ -24,6 +24,7 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
 
 
 #include <boost/property_tree/ptree_fwd.hpp>
@@ -35,6 +36,7 @@
 
 class QString;
 class OctMarkerIO;
+class MarkerSaveQueue;
 class SloBScanDistanceMap;
 
 namespace OctData
@@ -46,6 +48,7 @@ namespace OctData
 }
 
 class OctDataManagerThread;
+class SloDistanceMapThread;
 
 /**
  * @ingroup Manager
@@ -55,6 +58,7 @@ class OctDataManagerThread;
 class OctDataManager : public QObject
 {
 	friend class OctDataManagerThread;
+	friend class SloDistanceMapThread;
 
 	Q_OBJECT
 public:
@@ -77,19 +81,30 @@ private slots:
 	void loadOctDataThreadFinish();
 	void clearSeriesCache();
 
+	void distanceMapThreadProgress(double frac)                     { emit(seriesSLODistanceMapProgress(frac)); }
+	void distanceMapThreadFinish();
+
 public slots:
 	void openFile(const QString& filename);
 	
 	void chooseSeries(const std::shared_ptr<const OctData::Series>& seriesReq);
 
 
+	/**
+	 * @brief distance map of the actual series
+	 * The map is calculated in a background thread after the series has changed.
+	 * @return nullptr, while the calculation is running, seriesSLODistanceMapReady is emitted when the map is available
+	 */
 	const SloBScanDistanceMap* getSeriesSLODistanceMap() const;
 	
 	
 	virtual bool loadMarkers(QString filename, OctMarkerFileformat format);
 	virtual void saveMarkers(QString filename, OctMarkerFileformat format);
 	
+	/// writes the markers to the default marker file, blocks until written, throws on write errors
 	void triggerSaveMarkersDefault();
+	/// blocks until the markers saved in background by saveMarkersDefault are written, rethrows write errors
+	void waitForMarkerSaves();
 
 	void saveOctScan(QString filename);
 
@@ -111,11 +126,16 @@ signals:
 	void loadFileSignal(bool loading);
 	void loadFileProgress(double frac);
 
+	void seriesSLODistanceMapCalculation(bool calculating);
+	void seriesSLODistanceMapProgress(double frac);
+	void seriesSLODistanceMapReady();
+
 
 private:
 	
 	const std::unique_ptr<boost::property_tree::ptree> markerstree;
 	const std::unique_ptr<OctMarkerIO                > markerIO   ;
+	const std::unique_ptr<MarkerSaveQueue            > saveQueue  ;
 
 	QString actFilename;
 	
@@ -124,9 +144,14 @@ private:
 	std::shared_ptr<const OctData::Study  > actStudy  ;
 	std::shared_ptr<const OctData::Series > actSeries ;
 
-	mutable std::unique_ptr<SloBScanDistanceMap> seriesSLODistanceMap;
+	std::unique_ptr<SloBScanDistanceMap> seriesSLODistanceMap;
 	
 	std::unique_ptr<OctDataManagerThread> loadThread;
+	std::unique_ptr<SloDistanceMapThread> distanceMapThread;
+
+	void abortDistanceMapThread();
+	/// copy of the markers for the background save, false if no file is loaded
+	bool enqueueSaveMarkersDefault();
 	
 	OctDataManager();
 	OctDataManager& operator=(const OctDataManager& other) = delete;
@@ -180,3 +205,45 @@ signals:
 	void stepCalulated(double);
 };
 
+/**
+ * @ingroup Manager
+ * @brief Calculate the SLO distance map of a series in background
+ *
+ */
+class SloDistanceMapThread : public QThread, public CppFW::Callback
+{
+	Q_OBJECT
+
+	std::atomic<bool> breakCalculation{false};
+	bool calcSuccess     = false;
+	bool loadedFromCache = false;
+
+	const std::shared_ptr<const OctData::Series> series;
+	std::unique_ptr<SloBScanDistanceMap> distanceMap;
+
+	const std::string cacheDir;
+
+public:
+	/// @param cacheDir directory for the persistent distance map cache, an empty string disables the cache
+	SloDistanceMapThread(const std::shared_ptr<const OctData::Series>& series, const std::string& cacheDir);
+	~SloDistanceMapThread();
+
+	void breakCalc()                                                { breakCalculation = true; }
+
+	bool success()                                           const  { return calcSuccess; }
+	bool fromCache()                                         const  { return loadedFromCache; }
+	const std::shared_ptr<const OctData::Series>& getSeries() const { return series; }
+
+	std::unique_ptr<SloBScanDistanceMap> getDistanceMap();
+
+protected:
+	void run() override;
+
+	bool callback(double frac) override
+	{
+		emit(stepCalulated(frac));
+		return !breakCalculation;
+	}
+signals:
+	void stepCalulated(double);
+};
@@ -0,0 +1,928 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "octmarkerbinaryio.h"
+
+#include<istream>
+#include<fstream>
+#include<map>
+#include<ostream>
+#include<string>
+#include<vector>
+#include<algorithm>
+#include<cstring>
+#include<cmath>
+#include<cctype>
+#include<cstdint>
+#include<charconv>
+#include<limits>
+#include<stdexcept>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <helper/base64.h>
+
+namespace bpt = boost::property_tree;
+
+/*
+ * File layout (little-endian):
+ *   FileHeader
+ *   sections, children before the parent, the root section is the last one
+ *   table of contents: uint32 count, count x TocEntry
+ *   FileTrailer
+ *
+ * Section:     value, uint32 number of children, children
+ * Child:       uint8 NodeType, key (uint32 length + bytes), Inline: section content / SectionRef: uint32 section index
+ * Value:       uint8 ValueType + data
+ *   String:     uint32 length + bytes
+ *   DoubleList: uint8 element size (4: float, 8: double), uint32 count, values
+ *               (text: %g with precision 6 for DoubleList, shortest round trip for DoubleListRoundTrip)
+ *   IntList:    text prefix (uint32 length + bytes), uint8 element size (1, 2, 4), uint32 count, values
+ *   Base64Data: text prefix (uint32 length + bytes), decoded data (uint32 length + bytes)
+ */
+
+namespace
+{
+	namespace Constants
+	{
+		const char     headerMagic [8] = { 'O', 'C', 'T', 'M', 'R', 'K', 'B', '\0' };
+		const char     trailerMagic[8] = { 'O', 'C', 'T', 'M', 'T', 'O', 'C', '\0' };
+		const uint32_t version = 1;
+
+		// shorter values are always stored as string
+		const std::size_t minNumberListLength = 32;
+		const std::size_t maxBase64PrefixLength = 16;
+	}
+
+	enum class SectionType : uint8_t { Root, Patient, Study, Series, Module };
+	enum class NodeType    : uint8_t { Inline, SectionRef };
+	enum class ValueType   : uint8_t { String, DoubleList, IntList, DoubleListRoundTrip, Base64Data };
+
+	// text representation of the values of a double list
+	enum class Notation { Precision6, RoundTrip };
+
+	// position of a node in the marker tree, used to split the tree in sections
+	enum class TreeLevel { Document, Main, Markers, Patient, Study, Series, Module, Other };
+
+	struct TocEntry
+	{
+		SectionType type;
+		uint64_t    offset;
+		uint64_t    size;
+	};
+
+
+	// ------------------------------------------------------------------
+	// little-endian helpers
+
+	template<typename T>
+	void appendLE(std::string& buffer, T value)
+	{
+		unsigned char bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		std::reverse(bytes, bytes + sizeof(T));
+#endif
+		buffer.append(reinterpret_cast<const char*>(bytes), sizeof(T));
+	}
+
+	template<typename T>
+	T readLE(const char* data)
+	{
+		unsigned char bytes[sizeof(T)];
+		std::memcpy(bytes, data, sizeof(T));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		std::reverse(bytes, bytes + sizeof(T));
+#endif
+		T value;
+		std::memcpy(&value, bytes, sizeof(T));
+		return value;
+	}
+
+	template<typename T, typename S>
+	void appendArrayLE(std::string& buffer, const std::vector<S>& values)
+	{
+		const std::size_t offset = buffer.size();
+		buffer.resize(offset + values.size()*sizeof(T));
+		char* dest = &buffer[offset];
+		for(S v : values)
+		{
+			const T value = static_cast<T>(v);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			unsigned char bytes[sizeof(T)];
+			std::memcpy(bytes, &value, sizeof(T));
+			std::reverse(bytes, bytes + sizeof(T));
+			std::memcpy(dest, bytes, sizeof(T));
+#else
+			std::memcpy(dest, &value, sizeof(T));
+#endif
+			dest += sizeof(T);
+		}
+	}
+
+	void appendString(std::string& buffer, const std::string& str)
+	{
+		appendLE<uint32_t>(buffer, static_cast<uint32_t>(str.size()));
+		buffer.append(str);
+	}
+
+
+	// ------------------------------------------------------------------
+	// number lists, the text representation has to be reproduced exactly
+
+	// stream default format (%g with precision 6), fast path for the fixed notation, otherwise to_chars
+	char* formatDouble(char* first, char* last, double value)
+	{
+		static const double powers    [] = { 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+		static const double thresholds[] = { 1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4 };
+
+		const double absValue = std::fabs(value);
+		if(absValue >= 1e-4 && absValue < 1e5)
+		{
+			int exponent = 4;
+			while(absValue < thresholds[exponent + 4])
+				--exponent;
+
+			// 6 significant digits, the power is exact, so scaled is rounded only once
+			const double scaled      = absValue*powers[4 - exponent];
+			const double floorScaled = std::floor(scaled);
+			const double fraction    = scaled - floorScaled;
+			uint32_t digits = static_cast<uint32_t>(floorScaled) + (fraction > 0.5 ? 1 : 0);
+
+			// near a tie or a carry to the next exponent the exact rounding is left to to_chars
+			if(std::fabs(fraction - 0.5) > 1e-6 && digits >= 100000 && digits < 1000000)
+			{
+				char digitChars[6];
+				for(int i = 5; i >= 0; --i)
+				{
+					digitChars[i] = static_cast<char>('0' + digits%10);
+					digits /= 10;
+				}
+				const int intDigits = exponent + 1;
+				int numDigits = 6;
+				while(numDigits > std::max(intDigits, 1) && digitChars[numDigits-1] == '0')
+					--numDigits;
+
+				char* pos = first;
+				if(value < 0)
+					*pos++ = '-';
+				if(intDigits > 0)
+				{
+					std::memcpy(pos, digitChars, intDigits);
+					pos += intDigits;
+					if(numDigits > intDigits)
+					{
+						*pos++ = '.';
+						std::memcpy(pos, digitChars + intDigits, numDigits - intDigits);
+						pos += numDigits - intDigits;
+					}
+				}
+				else
+				{
+					*pos++ = '0';
+					*pos++ = '.';
+					for(int i = intDigits; i < 0; ++i)
+						*pos++ = '0';
+					std::memcpy(pos, digitChars, numDigits);
+					pos += numDigits;
+				}
+				return pos;
+			}
+		}
+		return std::to_chars(first, last, value, std::chars_format::general, 6).ptr;
+	}
+
+	char* formatDouble(char* first, char* last, double value, Notation notation)
+	{
+		if(notation == Notation::RoundTrip)
+			return std::to_chars(first, last, value).ptr;
+		return formatDouble(first, last, value);
+	}
+
+	bool formatsTo(double value, const char* token, std::size_t length, Notation notation)
+	{
+		char buffer[32];
+		const char* end = formatDouble(buffer, buffer + sizeof(buffer), value, notation);
+		return static_cast<std::size_t>(end - buffer) == length && std::memcmp(buffer, token, length) == 0;
+	}
+
+	// token in the fixed notation of %g with at most 6 significant digits: -?[1-9][0-9]*(.[0-9]*[1-9])? or -?0.0{0,3}[1-9][0-9]*
+	// the value of such a token is reproduced by formatDouble from the nearest float
+	// (relative float error < 6e-8, rounding to 6 digits needs an error < 5e-7)
+	bool isShortFixedToken(const char* pos, const char* end)
+	{
+		if(pos < end && *pos == '-')
+			++pos;
+		if(pos == end)
+			return false;
+
+		int significantDigits = 0;
+		if(*pos == '0')
+		{
+			++pos;
+			if(end - pos < 2 || *pos != '.')
+				return false;
+			++pos;
+			int zeros = 0;
+			while(pos < end && *pos == '0')
+			{
+				++zeros;
+				++pos;
+			}
+			if(zeros > 3 || pos == end)
+				return false;
+		}
+		else
+		{
+			while(pos < end && *pos >= '0' && *pos <= '9')
+			{
+				++significantDigits;
+				++pos;
+			}
+			if(significantDigits == 0 || significantDigits > 6)
+				return false;
+			if(pos == end)
+				return true;
+			if(*pos != '.' || end - pos < 2)
+				return false;
+			++pos;
+		}
+
+		while(pos < end && *pos >= '0' && *pos <= '9')
+		{
+			++significantDigits;
+			++pos;
+		}
+		return pos == end && significantDigits <= 6 && end[-1] != '0';
+	}
+
+	// format of BScanLayerSegPTree: every value followed by a space
+	template<typename T>
+	void formatDoubleList(const std::vector<T>& values, Notation notation, std::string& text)
+	{
+		text.resize(values.size()*32);
+		char* const begin = &text[0];
+		char* pos = begin;
+		for(T v : values)
+		{
+			pos = formatDouble(pos, pos + 31, static_cast<double>(v), notation);
+			*pos++ = ' ';
+		}
+		text.resize(static_cast<std::size_t>(pos - begin));
+	}
+
+	// parse and check that formatDoubleList reproduces the text,
+	// floatExact is true if the values are also reproduced by floatValues
+	bool parseDoubleList(const std::string& text, Notation notation, std::vector<double>& values, std::vector<float>& floatValues, bool& floatExact)
+	{
+		floatExact = true;
+		const char* pos = text.data();
+		const char* end = text.data() + text.size();
+		while(pos < end)
+		{
+			double value;
+			const std::from_chars_result result = std::from_chars(pos, end, value);
+			if(result.ec != std::errc() || result.ptr >= end || *result.ptr != ' ')
+				return false;
+
+			const std::size_t length = static_cast<std::size_t>(result.ptr - pos);
+			if(floatExact)
+			{
+				const float floatValue = static_cast<float>(value);
+				const bool exact = (notation == Notation::RoundTrip)
+				                 ? static_cast<double>(floatValue) == value && formatsTo(value, pos, length, notation)
+				                 : isShortFixedToken(pos, result.ptr) || formatsTo(floatValue, pos, length, notation);
+				if(exact)
+					floatValues.push_back(floatValue);
+				else
+					floatExact = false;
+			}
+			if(!floatExact && !formatsTo(value, pos, length, notation))
+				return false;
+
+			values.push_back(value);
+			pos = result.ptr + 1;
+		}
+		return !values.empty();
+	}
+
+	// text prefix followed by space separated integers (e.g. boost text archive of SimpleMatCompress)
+	void formatIntList(const std::string& prefix, const std::vector<int32_t>& values, std::string& text)
+	{
+		text = prefix;
+		text.reserve(prefix.size() + values.size()*4);
+		char buffer[16];
+		bool first = true;
+		for(int32_t v : values)
+		{
+			if(!first)
+				text += ' ';
+			first = false;
+			const std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), v);
+			text.append(buffer, result.ptr);
+		}
+	}
+
+	// smallest element size (1, 2 or 4 byte) for the values
+	uint8_t intElementSize(const std::vector<int32_t>& values)
+	{
+		int32_t minValue = 0;
+		int32_t maxValue = 0;
+		for(int32_t v : values)
+		{
+			minValue = std::min(minValue, v);
+			maxValue = std::max(maxValue, v);
+		}
+		if(minValue >= std::numeric_limits<int8_t >::min() && maxValue <= std::numeric_limits<int8_t >::max())
+			return 1;
+		if(minValue >= std::numeric_limits<int16_t>::min() && maxValue <= std::numeric_limits<int16_t>::max())
+			return 2;
+		return 4;
+	}
+
+	// the token is reproduced by to_chars (no sign, leading zeros or "-0")
+	bool isCanonicalInt(const char* begin, const char* end)
+	{
+		if(begin < end && *begin == '-')
+			++begin;
+		if(begin == end)
+			return false;
+		return *begin != '0' || (end - begin == 1 && begin[-1] != '-');
+	}
+
+	// split the text in a prefix and the trailing integer tokens
+	bool parseIntList(const std::string& text, std::string& prefix, std::vector<int32_t>& values)
+	{
+		const char* const begin = text.data();
+		const char*       tokenEnd = begin + text.size();
+		const char*       numbersStart = tokenEnd;
+		while(tokenEnd > begin)
+		{
+			const char* tokenBegin = tokenEnd;
+			while(tokenBegin > begin && tokenBegin[-1] != ' ')
+				--tokenBegin;
+
+			int32_t value;
+			const std::from_chars_result result = std::from_chars(tokenBegin, tokenEnd, value);
+			if(result.ec != std::errc() || result.ptr != tokenEnd || !isCanonicalInt(tokenBegin, tokenEnd))
+				break;
+
+			values.push_back(value);
+			numbersStart = tokenBegin;
+			if(tokenBegin == begin)
+				break;
+			tokenEnd = tokenBegin - 1;
+		}
+		if(values.empty())
+			return false;
+
+		std::reverse(values.begin(), values.end());
+		prefix.assign(begin, numbersStart);
+		return true;
+	}
+
+
+	// "<prefix>:<base64>" with a prefix of letters and digits (e.g. SimpleMatCompress::toString)
+	bool parseBase64Value(const std::string& text, std::size_t& prefixLength, std::string& data)
+	{
+		const std::size_t searchLength = std::min(text.size(), Constants::maxBase64PrefixLength + 1);
+		const char* colon = static_cast<const char*>(std::memchr(text.data(), ':', searchLength));
+		if(!colon || colon == text.data())
+			return false;
+
+		for(const char* pos = text.data(); pos < colon; ++pos)
+			if(!std::isalnum(static_cast<unsigned char>(*pos)))
+				return false;
+
+		prefixLength = static_cast<std::size_t>(colon - text.data()) + 1;
+		return Base64::decode(text.data() + prefixLength, text.size() - prefixLength, data);
+	}
+
+
+	// ------------------------------------------------------------------
+	// writer
+
+	class Writer
+	{
+		std::ostream& stream;
+		uint64_t      position = 0;
+		std::vector<TocEntry> toc;
+
+		const OctMarkerBinaryIO::RawModuleSections* rawModules;
+
+		std::vector<double>  doubleBuffer;
+		std::vector<float>   floatBuffer;
+		std::vector<int32_t> intBuffer;
+		std::string          prefixBuffer;
+		std::string          dataBuffer;
+
+		static TreeLevel childLevel(TreeLevel level, const std::string& key, const bpt::ptree& child)
+		{
+			switch(level)
+			{
+				case TreeLevel::Document: return key == "OctMarker" ? TreeLevel::Main    : TreeLevel::Other;
+				case TreeLevel::Main    : return key == "Markers"   ? TreeLevel::Markers : TreeLevel::Other;
+				case TreeLevel::Markers : return key == "Patient"   ? TreeLevel::Patient : TreeLevel::Other;
+				case TreeLevel::Patient : return key == "Study"     ? TreeLevel::Study   : TreeLevel::Other;
+				case TreeLevel::Study   : return key == "Series"    ? TreeLevel::Series  : TreeLevel::Other;
+				case TreeLevel::Series  : return child.empty()      ? TreeLevel::Other   : TreeLevel::Module;
+				case TreeLevel::Module  :
+				case TreeLevel::Other   : break;
+			}
+			return TreeLevel::Other;
+		}
+
+		static bool isSection(TreeLevel level, SectionType& type)
+		{
+			switch(level)
+			{
+				case TreeLevel::Patient: type = SectionType::Patient; return true;
+				case TreeLevel::Study  : type = SectionType::Study  ; return true;
+				case TreeLevel::Series : type = SectionType::Series ; return true;
+				case TreeLevel::Module : type = SectionType::Module ; return true;
+				default:
+					return false;
+			}
+		}
+
+		void appendValue(std::string& buffer, const std::string& value)
+		{
+			if(value.size() >= Constants::minNumberListLength)
+			{
+				std::size_t prefixLength;
+				if(parseBase64Value(value, prefixLength, dataBuffer))
+				{
+					buffer.push_back(static_cast<char>(ValueType::Base64Data));
+					appendLE<uint32_t>(buffer, static_cast<uint32_t>(prefixLength));
+					buffer.append(value, 0, prefixLength);
+					appendString(buffer, dataBuffer);
+					return;
+				}
+
+				for(Notation notation : { Notation::Precision6, Notation::RoundTrip })
+				{
+					bool floatExact;
+					doubleBuffer.clear();
+					floatBuffer .clear();
+					if(!parseDoubleList(value, notation, doubleBuffer, floatBuffer, floatExact))
+						continue;
+
+					buffer.push_back(static_cast<char>(notation == Notation::RoundTrip ? ValueType::DoubleListRoundTrip : ValueType::DoubleList));
+					if(floatExact)
+					{
+						buffer.push_back(static_cast<char>(sizeof(float)));
+						appendLE<uint32_t>(buffer, static_cast<uint32_t>(floatBuffer.size()));
+						appendArrayLE<float>(buffer, floatBuffer);
+					}
+					else
+					{
+						buffer.push_back(static_cast<char>(sizeof(double)));
+						appendLE<uint32_t>(buffer, static_cast<uint32_t>(doubleBuffer.size()));
+						appendArrayLE<double>(buffer, doubleBuffer);
+					}
+					return;
+				}
+
+				intBuffer.clear();
+				if(parseIntList(value, prefixBuffer, intBuffer))
+				{
+					const uint8_t elementSize = intElementSize(intBuffer);
+					buffer.push_back(static_cast<char>(ValueType::IntList));
+					appendString(buffer, prefixBuffer);
+					buffer.push_back(static_cast<char>(elementSize));
+					appendLE<uint32_t>(buffer, static_cast<uint32_t>(intBuffer.size()));
+					switch(elementSize)
+					{
+						case 1: appendArrayLE<int8_t >(buffer, intBuffer); break;
+						case 2: appendArrayLE<int16_t>(buffer, intBuffer); break;
+						default:appendArrayLE<int32_t>(buffer, intBuffer); break;
+					}
+					return;
+				}
+			}
+
+			buffer.push_back(static_cast<char>(ValueType::String));
+			appendString(buffer, value);
+		}
+
+		void appendNodeContent(std::string& buffer, const bpt::ptree& node, TreeLevel level)
+		{
+			appendValue(buffer, node.data());
+			appendLE<uint32_t>(buffer, static_cast<uint32_t>(node.size()));
+
+			for(const std::pair<const std::string, bpt::ptree>& child : node)
+			{
+				if(rawModules && level == TreeLevel::Series)
+				{
+					OctMarkerBinaryIO::RawModuleSections::const_iterator rawModule = rawModules->find(&child.second);
+					if(rawModule != rawModules->end())
+					{
+						const uint32_t sectionIndex = writeRawSection(rawModule->second, SectionType::Module);
+						buffer.push_back(static_cast<char>(NodeType::SectionRef));
+						appendString(buffer, child.first);
+						appendLE<uint32_t>(buffer, sectionIndex);
+						continue;
+					}
+				}
+
+				const TreeLevel level4Child = childLevel(level, child.first, child.second);
+				SectionType sectionType;
+				if(isSection(level4Child, sectionType))
+				{
+					const uint32_t sectionIndex = writeSection(child.second, level4Child, sectionType);
+					buffer.push_back(static_cast<char>(NodeType::SectionRef));
+					appendString(buffer, child.first);
+					appendLE<uint32_t>(buffer, sectionIndex);
+				}
+				else
+				{
+					buffer.push_back(static_cast<char>(NodeType::Inline));
+					appendString(buffer, child.first);
+					appendNodeContent(buffer, child.second, level4Child);
+				}
+			}
+		}
+
+		void writeBuffer(const std::string& buffer)
+		{
+			stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			position += buffer.size();
+		}
+
+		uint32_t writeRawSection(const std::string& buffer, SectionType type)
+		{
+			const uint64_t offset = position;
+			writeBuffer(buffer);
+
+			toc.push_back(TocEntry{type, offset, buffer.size()});
+			return static_cast<uint32_t>(toc.size() - 1);
+		}
+
+	public:
+		Writer(std::ostream& stream, const OctMarkerBinaryIO::RawModuleSections* rawModules)
+		: stream(stream)
+		, rawModules(rawModules)
+		{}
+
+		// the sub sections are written before the section, returns the index in the table of contents
+		uint32_t writeSection(const bpt::ptree& node, TreeLevel level, SectionType type)
+		{
+			std::string buffer;
+			appendNodeContent(buffer, node, level);
+			return writeRawSection(buffer, type);
+		}
+
+		void write(const bpt::ptree& tree)
+		{
+			std::string header(Constants::headerMagic, sizeof(Constants::headerMagic));
+			appendLE<uint32_t>(header, Constants::version);
+			appendLE<uint32_t>(header, 0); // reserved
+			writeBuffer(header);
+
+			writeSection(tree, TreeLevel::Document, SectionType::Root);
+
+			const uint64_t tocOffset = position;
+			std::string tocBuffer;
+			appendLE<uint32_t>(tocBuffer, static_cast<uint32_t>(toc.size()));
+			for(const TocEntry& entry : toc)
+			{
+				tocBuffer.push_back(static_cast<char>(entry.type));
+				appendLE<uint64_t>(tocBuffer, entry.offset);
+				appendLE<uint64_t>(tocBuffer, entry.size);
+			}
+			appendLE<uint64_t>(tocBuffer, tocOffset);
+			tocBuffer.append(Constants::trailerMagic, sizeof(Constants::trailerMagic));
+			writeBuffer(tocBuffer);
+		}
+	};
+
+
+	// ------------------------------------------------------------------
+	// reader
+
+	class Reader
+	{
+	public:
+		// module sections which are not read yet, by series node: (module node, section index)
+		typedef std::map<const bpt::ptree*, std::vector<std::pair<bpt::ptree*, uint32_t>>> DeferredSections;
+
+	private:
+		std::istream& stream;
+		std::vector<TocEntry> toc;
+
+		DeferredSections* deferredModules = nullptr;
+
+		std::vector<double>  doubleBuffer;
+		std::vector<float>   floatBuffer;
+		std::vector<int32_t> intBuffer;
+		std::string          textBuffer;
+
+		class Cursor
+		{
+			const std::string& data;
+			std::size_t pos = 0;
+		public:
+			explicit Cursor(const std::string& data) : data(data) {}
+
+			const char* take(std::size_t length)
+			{
+				if(length > data.size() - pos)
+					throw std::runtime_error("OctMarkerBinaryIO: unexpected end of section");
+				const char* ptr = data.data() + pos;
+				pos += length;
+				return ptr;
+			}
+			template<typename T> T get() { return readLE<T>(take(sizeof(T))); }
+			std::string getString()
+			{
+				const uint32_t length = get<uint32_t>();
+				return std::string(take(length), length);
+			}
+		};
+
+		void readBytes(uint64_t offset, std::string& buffer, std::size_t size)
+		{
+			buffer.resize(size);
+			stream.seekg(static_cast<std::streamoff>(offset));
+			stream.read(&buffer[0], static_cast<std::streamsize>(size));
+			if(!stream)
+				throw std::runtime_error("OctMarkerBinaryIO: read error");
+		}
+
+		template<typename T>
+		static void readArray(Cursor& cursor, uint32_t count, std::vector<T>& values)
+		{
+			const char* data = cursor.take(static_cast<std::size_t>(count)*sizeof(T));
+			values.resize(count);
+			for(uint32_t i = 0; i < count; ++i)
+				values[i] = readLE<T>(data + i*sizeof(T));
+		}
+
+		void readValue(Cursor& cursor, bpt::ptree& node)
+		{
+			const ValueType type = static_cast<ValueType>(cursor.get<uint8_t>());
+			switch(type)
+			{
+				case ValueType::String:
+					node.put_value(cursor.getString());
+					return;
+				case ValueType::DoubleList:
+				case ValueType::DoubleListRoundTrip:
+				{
+					const Notation notation    = (type == ValueType::DoubleListRoundTrip) ? Notation::RoundTrip : Notation::Precision6;
+					const uint8_t  elementSize = cursor.get<uint8_t >();
+					const uint32_t count       = cursor.get<uint32_t>();
+					if(elementSize == sizeof(float))
+					{
+						readArray(cursor, count, floatBuffer);
+						formatDoubleList(floatBuffer, notation, textBuffer);
+					}
+					else if(elementSize == sizeof(double))
+					{
+						readArray(cursor, count, doubleBuffer);
+						formatDoubleList(doubleBuffer, notation, textBuffer);
+					}
+					else
+						throw std::runtime_error("OctMarkerBinaryIO: invalid element size");
+					node.data().swap(textBuffer);
+					return;
+				}
+				case ValueType::IntList:
+				{
+					const std::string prefix      = cursor.getString();
+					const uint8_t     elementSize = cursor.get<uint8_t >();
+					const uint32_t    count       = cursor.get<uint32_t>();
+					intBuffer.resize(count);
+					const char* data = cursor.take(static_cast<std::size_t>(count)*elementSize);
+					for(uint32_t i = 0; i < count; ++i)
+					{
+						switch(elementSize)
+						{
+							case 1: intBuffer[i] = readLE<int8_t >(data + i  ); break;
+							case 2: intBuffer[i] = readLE<int16_t>(data + i*2); break;
+							case 4: intBuffer[i] = readLE<int32_t>(data + i*4); break;
+							default:
+								throw std::runtime_error("OctMarkerBinaryIO: invalid element size");
+						}
+					}
+					formatIntList(prefix, intBuffer, textBuffer);
+					node.data().swap(textBuffer);
+					return;
+				}
+				case ValueType::Base64Data:
+				{
+					std::string text = cursor.getString();
+					const uint32_t length = cursor.get<uint32_t>();
+					Base64::encode(cursor.take(length), length, textBuffer);
+					text += textBuffer;
+					node.data().swap(text);
+					return;
+				}
+			}
+			throw std::runtime_error("OctMarkerBinaryIO: unknown value type");
+		}
+
+		void readNodeContent(Cursor& cursor, bpt::ptree& node, std::size_t depth)
+		{
+			if(depth > 1000)
+				throw std::runtime_error("OctMarkerBinaryIO: tree too deep");
+
+			readValue(cursor, node);
+			const uint32_t numChildren = cursor.get<uint32_t>();
+			for(uint32_t i = 0; i < numChildren; ++i)
+			{
+				const NodeType nodeType = static_cast<NodeType>(cursor.get<uint8_t>());
+				bpt::ptree& child = node.push_back(std::make_pair(cursor.getString(), bpt::ptree()))->second;
+				switch(nodeType)
+				{
+					case NodeType::Inline:
+						readNodeContent(cursor, child, depth + 1);
+						break;
+					case NodeType::SectionRef:
+					{
+						const uint32_t sectionIndex = cursor.get<uint32_t>();
+						if(deferredModules && sectionIndex < toc.size() && toc[sectionIndex].type == SectionType::Module)
+							(*deferredModules)[&node].emplace_back(&child, sectionIndex);
+						else
+							readSection(sectionIndex, child, depth + 1);
+						break;
+					}
+					default:
+						throw std::runtime_error("OctMarkerBinaryIO: unknown node type");
+				}
+			}
+		}
+
+	public:
+		explicit Reader(std::istream& stream) : stream(stream) {}
+
+		void setDeferredModules(DeferredSections* deferred) { deferredModules = deferred; }
+
+		void readSectionData(uint32_t index, std::string& buffer)
+		{
+			if(index >= toc.size())
+				throw std::runtime_error("OctMarkerBinaryIO: invalid section index");
+
+			readBytes(toc[index].offset, buffer, toc[index].size);
+		}
+
+		void readSection(uint32_t index, bpt::ptree& node, std::size_t depth)
+		{
+			std::string buffer;
+			readSectionData(index, buffer);
+			Cursor cursor(buffer);
+			readNodeContent(cursor, node, depth);
+		}
+
+		void readToc()
+		{
+			std::string header;
+			readBytes(0, header, sizeof(Constants::headerMagic) + 2*sizeof(uint32_t));
+			if(std::memcmp(header.data(), Constants::headerMagic, sizeof(Constants::headerMagic)) != 0)
+				throw std::runtime_error("OctMarkerBinaryIO: no binary octmarker file");
+			if(readLE<uint32_t>(header.data() + sizeof(Constants::headerMagic)) != Constants::version)
+				throw std::runtime_error("OctMarkerBinaryIO: unsupported version");
+
+			const std::size_t trailerSize = sizeof(uint64_t) + sizeof(Constants::trailerMagic);
+			stream.seekg(0, std::ios::end);
+			const uint64_t fileSize = static_cast<uint64_t>(stream.tellg());
+			if(fileSize < header.size() + trailerSize)
+				throw std::runtime_error("OctMarkerBinaryIO: file too short");
+
+			std::string trailer;
+			readBytes(fileSize - trailerSize, trailer, trailerSize);
+			if(std::memcmp(trailer.data() + sizeof(uint64_t), Constants::trailerMagic, sizeof(Constants::trailerMagic)) != 0)
+				throw std::runtime_error("OctMarkerBinaryIO: table of contents not found");
+
+			const uint64_t tocOffset = readLE<uint64_t>(trailer.data());
+			if(tocOffset > fileSize - trailerSize)
+				throw std::runtime_error("OctMarkerBinaryIO: invalid table of contents");
+
+			std::string tocBuffer;
+			readBytes(tocOffset, tocBuffer, static_cast<std::size_t>(fileSize - trailerSize - tocOffset));
+			Cursor cursor(tocBuffer);
+			const uint32_t numEntries = cursor.get<uint32_t>();
+			toc.resize(numEntries);
+			for(TocEntry& entry : toc)
+			{
+				entry.type   = static_cast<SectionType>(cursor.get<uint8_t>());
+				entry.offset = cursor.get<uint64_t>();
+				entry.size   = cursor.get<uint64_t>();
+				if(entry.offset > tocOffset || entry.size > tocOffset - entry.offset)
+					throw std::runtime_error("OctMarkerBinaryIO: invalid section entry");
+			}
+
+			if(toc.empty() || toc.back().type != SectionType::Root)
+				throw std::runtime_error("OctMarkerBinaryIO: root section not found");
+		}
+
+		void read(bpt::ptree& tree)
+		{
+			readToc();
+			tree.clear();
+			readSection(static_cast<uint32_t>(toc.size() - 1), tree, 0);
+		}
+	};
+}
+
+
+class OctMarkerBinaryLazyReader::Impl
+{
+public:
+	std::ifstream stream;
+	Reader        reader;
+	Reader::DeferredSections deferredModules;
+
+	explicit Impl(const std::filesystem::path& file)
+	: stream(file, std::ios::in | std::ios::binary)
+	, reader(stream)
+	{
+		if(!stream)
+			throw std::runtime_error("OctMarkerBinaryIO: can't open " + file.generic_string());
+		reader.setDeferredModules(&deferredModules);
+	}
+};
+
+
+OctMarkerBinaryLazyReader::OctMarkerBinaryLazyReader(const std::filesystem::path& file)
+: impl(std::make_unique<Impl>(file))
+{
+}
+
+OctMarkerBinaryLazyReader::~OctMarkerBinaryLazyReader() = default;
+
+void OctMarkerBinaryLazyReader::read(boost::property_tree::ptree& tree)
+{
+	impl->deferredModules.clear();
+	impl->reader.read(tree);
+}
+
+bool OctMarkerBinaryLazyReader::loadSeries(const boost::property_tree::ptree& seriesNode)
+{
+	Reader::DeferredSections::iterator it = impl->deferredModules.find(&seriesNode);
+	if(it == impl->deferredModules.end())
+		return false;
+
+	// the section is dropped before reading, a damaged section is not read again
+	const Reader::DeferredSections::mapped_type modules = std::move(it->second);
+	impl->deferredModules.erase(it);
+
+	try
+	{
+		for(const std::pair<bpt::ptree*, uint32_t>& module : modules)
+			impl->reader.readSection(module.second, *module.first, 0);
+	}
+	catch(...)
+	{
+		for(const std::pair<bpt::ptree*, uint32_t>& module : modules)
+			module.first->clear();
+		throw;
+	}
+	return true;
+}
+
+void OctMarkerBinaryLazyReader::loadAll()
+{
+	while(!impl->deferredModules.empty())
+		loadSeries(*impl->deferredModules.begin()->first);
+}
+
+bool OctMarkerBinaryLazyReader::hasDeferredSeries() const
+{
+	return !impl->deferredModules.empty();
+}
+
+void OctMarkerBinaryLazyReader::readDeferredModules(OctMarkerBinaryIO::RawModuleSections& rawModules)
+{
+	for(const Reader::DeferredSections::value_type& series : impl->deferredModules)
+		for(const std::pair<bpt::ptree*, uint32_t>& module : series.second)
+			impl->reader.readSectionData(module.second, rawModules[module.first]);
+}
+
+
+void OctMarkerBinaryIO::write(std::ostream& stream, const boost::property_tree::ptree& tree, const RawModuleSections* rawModules)
+{
+	Writer writer(stream, rawModules);
+	writer.write(tree);
+}
+
+void OctMarkerBinaryIO::read(std::istream& stream, boost::property_tree::ptree& tree)
+{
+	Reader reader(stream);
+	reader.read(tree);
+}
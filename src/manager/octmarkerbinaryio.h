@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef OCTMARKERBINARYIO_H
+#define OCTMARKERBINARYIO_H
+
+#include<iosfwd>
+#include<memory>
+#include<filesystem>
+#include<map>
+#include<string>
+#include<boost/property_tree/ptree_fwd.hpp>
+
+/**
+ * @ingroup Manager
+ * @brief Binary serialization of the marker property tree (OctMarkerFileformat::Binary)
+ *
+ * The file is split in sections (patient, study, series and module nodes), the sections are
+ * listed in a table of contents at the end of the file. Values which are lists of numbers
+ * (segmentation lines, compressed masks) are stored as little-endian arrays, if the text
+ * representation can be restored exactly, otherwise as string. A read tree is equal to the
+ * written tree, so the format can be converted loss-free to the text formats.
+ */
+class OctMarkerBinaryIO
+{
+public:
+	/// encoded module sections of a binary marker file, by the (empty) module node of the tree to write
+	typedef std::map<const boost::property_tree::ptree*, std::string> RawModuleSections;
+
+	/// the module nodes in rawModules are written as the given sections, without encoding
+	static void write(std::ostream& stream, const boost::property_tree::ptree& tree, const RawModuleSections* rawModules = nullptr);
+	static void read (std::istream& stream,       boost::property_tree::ptree& tree);
+};
+
+
+/**
+ * @ingroup Manager
+ * @brief Indexed read of a binary marker file, the module sections of a series are read on request
+ *
+ * read() builds the tree from the patient, study and series sections, the module nodes of the
+ * series are left empty. loadSeries() fills them from the file when the series is used.
+ * The series nodes are identified by address, so the tree must not be copied or the nodes
+ * removed while sections are deferred (swap keeps the addresses).
+ */
+class OctMarkerBinaryLazyReader
+{
+	class Impl;
+	std::unique_ptr<Impl> impl;
+public:
+	explicit OctMarkerBinaryLazyReader(const std::filesystem::path& file);
+	~OctMarkerBinaryLazyReader();
+
+	void read(boost::property_tree::ptree& tree);
+
+	bool loadSeries(const boost::property_tree::ptree& seriesNode);
+	void loadAll();
+	bool hasDeferredSeries() const;
+
+	/// the not yet read module sections as stored in the file, by module node
+	void readDeferredModules(OctMarkerBinaryIO::RawModuleSections& rawModules);
+};
+
+#endif // OCTMARKERBINARYIO_H
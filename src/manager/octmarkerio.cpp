@@ -20,14 +20,17 @@
 
 #include<filesystem>
 
-#ifndef MEX_COMPILE
+#if defined(MEX_COMPILE)
+	#define DEBUG_OUT(X) std::cerr << X;
+#elif defined(HEADLESS_COMPILE)
+	#define DEBUG_OUT(X)
+#else
 	#include <data_structure/programoptions.h>
 	#define DEBUG_OUT(X) qDebug(X);
-#else
-	#define DEBUG_OUT(X) std::cerr << X;
 #endif
 
 #include <helper/ptreehelper.h>
+#include "octmarkerbinaryio.h"
 #include <oct_cpp_framework/platform_helper/filename_unicode.h>
 
 #include <boost/property_tree/ptree.hpp>
@@ -40,6 +43,7 @@
 #include <iostream>
 
 #include<string>
+#include<stdexcept>
 
 namespace pt = boost::property_tree;
 namespace io = boost::iostreams;
@@ -60,6 +64,35 @@ namespace
 		const char* mainNodeName = "OctMarker";
 		const int   version      = 1;
 	}
+
+	/// moves the marker tree into the wrapper node for saving and back on destruction (also on exceptions)
+	class TreeLender
+	{
+		bpt::ptree& owner;
+		bpt::ptree& borrower;
+	public:
+		TreeLender(bpt::ptree& owner, bpt::ptree& borrower) : owner(owner), borrower(borrower) { owner.swap(borrower); }
+		~TreeLender()                                                                            { owner.swap(borrower); }
+
+		TreeLender(const TreeLender&) = delete;
+		TreeLender& operator=(const TreeLender&) = delete;
+	};
+
+	// moves the sections of the module nodes of orig to the module nodes at the same place in copy
+	void mapCopiedModules(const bpt::ptree& orig, const bpt::ptree& copy, OctMarkerBinaryIO::RawModuleSections& origModules, OctMarkerBinaryIO::RawModuleSections& copyModules, int depth)
+	{
+		const int seriesDepth = 3; // patient, study, series
+		bpt::ptree::const_iterator copyIt = copy.begin();
+		for(const std::pair<const std::string, bpt::ptree>& child : orig)
+		{
+			OctMarkerBinaryIO::RawModuleSections::iterator module = origModules.find(&child.second);
+			if(module != origModules.end())
+				copyModules[&copyIt->second] = std::move(module->second);
+			else if(depth < seriesDepth)
+				mapCopiedModules(child.second, copyIt->second, origModules, copyModules, depth + 1);
+			++copyIt;
+		}
+	}
 }
 
 
@@ -69,9 +102,11 @@ OctMarkerIO::OctMarkerIO(boost::property_tree::ptree* markerTree)
 	
 }
 
+OctMarkerIO::~OctMarkerIO() = default;
+
 OctMarkerFileformat OctMarkerIO::getDefaultFileFormat()
 {
-#ifndef MEX_COMPILE
+#if !defined(MEX_COMPILE) && !defined(HEADLESS_COMPILE)
 	OctMarkerFileformat format = int2Fileformat(ProgramOptions::defaultFileformatOctMarkers());
 #else
 	OctMarkerFileformat format = OctMarkerFileformat::INFO;
@@ -82,6 +117,7 @@ OctMarkerFileformat OctMarkerIO::getDefaultFileFormat()
 		case OctMarkerFileformat::XML:
 		case OctMarkerFileformat::Json:
 		case OctMarkerFileformat::INFO:
+		case OctMarkerFileformat::Binary:
 			return format;
 		case OctMarkerFileformat::Unknown:
 		case OctMarkerFileformat::Auto:
@@ -102,6 +138,8 @@ int OctMarkerIO::fileformat2Int(OctMarkerFileformat format)
 			return static_cast<int>(OctMarkerFileformat::Json);
 		case OctMarkerFileformat::INFO:
 			return static_cast<int>(OctMarkerFileformat::INFO);
+		case OctMarkerFileformat::Binary:
+			return static_cast<int>(OctMarkerFileformat::Binary);
 		case OctMarkerFileformat::Unknown:
 		case OctMarkerFileformat::Auto:
 		case OctMarkerFileformat::NoExtension:
@@ -120,6 +158,8 @@ OctMarkerFileformat OctMarkerIO::int2Fileformat(int formatId)
 			return OctMarkerFileformat::Json;
 		case static_cast<int>(OctMarkerFileformat::INFO):
 			return OctMarkerFileformat::INFO;
+		case static_cast<int>(OctMarkerFileformat::Binary):
+			return OctMarkerFileformat::Binary;
 	}
 	return OctMarkerFileformat::Unknown;
 }
@@ -146,6 +186,8 @@ OctMarkerFileformat OctMarkerIO::getFormatFromExtension(const std::filesystem::p
 		return OctMarkerFileformat::XML;
 	if(extension == getFileExtension(OctMarkerFileformat::INFO))
 		return OctMarkerFileformat::INFO;
+	if(extension == getFileExtension(OctMarkerFileformat::Binary))
+		return OctMarkerFileformat::Binary;
 
 	return OctMarkerFileformat::Unknown;
 }
@@ -161,6 +203,8 @@ const char* OctMarkerIO::getFileExtension(OctMarkerFileformat format)
 			return "xoctmarker";
 		case OctMarkerFileformat::INFO:
 			return "ioctmarker";
+		case OctMarkerFileformat::Binary:
+			return "boctmarker";
 		case OctMarkerFileformat::Unknown:
 		case OctMarkerFileformat::Auto:
 		case OctMarkerFileformat::NoExtension:
@@ -178,10 +222,12 @@ std::string OctMarkerIO::addMarkerExtension(const std::string& file, OctMarkerFi
 
 bool OctMarkerIO::loadDefaultMarker(const std::string& octFilename)
 {
+	lazyReader.reset();
 	loadedDefaultFilename.clear();
 	OctMarkerFileformat formats[] = { OctMarkerFileformat::Json,
 	                                  OctMarkerFileformat::XML,
-	                                  OctMarkerFileformat::INFO };
+	                                  OctMarkerFileformat::INFO,
+	                                  OctMarkerFileformat::Binary };
 	
 	for(std::size_t i = 0; i < sizeof(formats)/sizeof(formats[0]); ++i)
 	{
@@ -213,6 +259,8 @@ bool OctMarkerIO::saveDefaultMarker(const std::string& octFilename)
 
 bool OctMarkerIO::loadMarkers(const std::filesystem::path& markersPath, OctMarkerFileformat format)
 {
+	lazyReader.reset();
+
 	if(format == OctMarkerFileformat::Auto)
 		format = getFormatFromExtension(markersPath);
 	if(format == OctMarkerFileformat::Unknown
@@ -226,6 +274,7 @@ bool OctMarkerIO::loadMarkers(const std::filesystem::path& markersPath, OctMarke
 	DEBUG_OUT(loadString.c_str());
 
 	bpt::ptree loadTree;
+	std::unique_ptr<OctMarkerBinaryLazyReader> newLazyReader;
 
     io::file_descriptor_source fs(markersPath.generic_string());
     io::stream<io::file_descriptor_source> fsstream(fs);
@@ -241,6 +290,15 @@ bool OctMarkerIO::loadMarkers(const std::filesystem::path& markersPath, OctMarke
 		case OctMarkerFileformat::INFO:
 			bpt::read_info(fsstream, loadTree);
 			break;
+		case OctMarkerFileformat::Binary:
+			if(lazySeriesLoading)
+			{
+				newLazyReader = std::make_unique<OctMarkerBinaryLazyReader>(markersPath);
+				newLazyReader->read(loadTree);
+			}
+			else
+				OctMarkerBinaryIO::read(fsstream, loadTree);
+			break;
 		case OctMarkerFileformat::Auto: // avoid compiler warnings
 		case OctMarkerFileformat::Unknown:
 		case OctMarkerFileformat::NoExtension:
@@ -248,24 +306,47 @@ bool OctMarkerIO::loadMarkers(const std::filesystem::path& markersPath, OctMarke
 	}
 
 	boost::optional<bpt::ptree&> nodeMain = loadTree.get_child_optional(Constants::mainNodeName);
-	if(!nodeMain)
-		return false;
+	boost::optional<bpt::ptree&> nodeVersion;
+	boost::optional<bpt::ptree&> nodeMarkers;
+	if(nodeMain)
+	{
+		nodeVersion = nodeMain->get_child_optional("Version");
+		nodeMarkers = nodeMain->get_child_optional("Markers");
+	}
 
-	boost::optional<bpt::ptree&> nodeVersion = nodeMain->get_child_optional("Version");
-	if(!nodeVersion)
+	if(!nodeVersion || nodeVersion->get_value<int>(0) != Constants::version || !nodeMarkers)
 		return false;
 
-	if(nodeVersion->get_value<int>(0) != Constants::version)
-		return false;
+	// no copy of the tree, the deferred series of lazyReader are identified by the node address
+	markerstree->swap(*nodeMarkers);
+	lazyReader = std::move(newLazyReader);
 
+	return true;
+}
 
-	boost::optional<bpt::ptree&> nodeMarkers = nodeMain->get_child_optional("Markers");
-	if(!nodeMarkers)
-		return false;
 
-	*markerstree = *nodeMarkers;
+void OctMarkerIO::loadSeriesMarkers(const boost::property_tree::ptree& seriesNode)
+{
+	if(!lazyReader)
+		return;
 
-	return true;
+	lazyReader->loadSeries(seriesNode);
+	if(!lazyReader->hasDeferredSeries())
+		lazyReader.reset();
+}
+
+void OctMarkerIO::loadAllSeriesMarkers()
+{
+	if(!lazyReader)
+		return;
+
+	lazyReader->loadAll();
+	lazyReader.reset();
+}
+
+void OctMarkerIO::dropDeferredSeries()
+{
+	lazyReader.reset();
 }
 
 
@@ -276,52 +357,143 @@ bool OctMarkerIO::loadMarkers(const std::string& markersFilename, OctMarkerFilef
 	return loadMarkers(markersPath, format);
 }
 
-bool OctMarkerIO::saveMarkers(const std::string& markersFilename, OctMarkerFileformat format)
+bool OctMarkerIO::resolveSaveFormat(std::string& markersFilename, OctMarkerFileformat& format) const
 {
 	if(format == OctMarkerFileformat::Auto)
 		format = getFormatFromExtension(markersFilename);
 	if(format == OctMarkerFileformat::NoExtension)
 	{
-		OctMarkerFileformat defaultFileFormat = getDefaultFileFormat();
-		return saveMarkersPrivat(addMarkerExtension(markersFilename, defaultFileFormat), defaultFileFormat);
+		format = getDefaultFileFormat();
+		markersFilename = addMarkerExtension(markersFilename, format);
 	}
-	if(format == OctMarkerFileformat::Unknown)
+	return format != OctMarkerFileformat::Unknown
+	    && format != OctMarkerFileformat::Auto
+	    && format != OctMarkerFileformat::NoExtension;
+}
+
+bool OctMarkerIO::saveMarkers(const std::string& markersFilename, OctMarkerFileformat format)
+{
+	std::string filename = markersFilename;
+	if(!resolveSaveFormat(filename, format))
 		return false;
 	
-	return saveMarkersPrivat(markersFilename, format);
+	return saveMarkersPrivat(filename, format);
 }
 
 
-bool OctMarkerIO::saveMarkersPrivat(const std::string& markersFilename, OctMarkerFileformat format)
+bool OctMarkerIO::createDefaultMarkerSnapshot(const std::string& octFilename, SaveSnapshot& snapshot)
+{
+	snapshot.format   = defaultLoadedFormat;
+	snapshot.filename = loadedDefaultFilename.empty() ? addMarkerExtension(octFilename, defaultLoadedFormat) : loadedDefaultFilename;
+	if(!resolveSaveFormat(snapshot.filename, snapshot.format))
+		return false;
+
+	std::shared_ptr<bpt::ptree> saveTree = std::make_shared<bpt::ptree>();
+	bpt::ptree& markersNode = putSaveTree(*saveTree);
+
+	if(copyDeferredModules(snapshot.format))
+	{
+		OctMarkerBinaryIO::RawModuleSections rawModules;
+		lazyReader->readDeferredModules(rawModules);
+		markersNode = *markerstree;
+		mapCopiedModules(*markerstree, markersNode, rawModules, snapshot.rawModules, 0);
+	}
+	else
+	{
+		// the marker file is replaced, so all deferred series have to be read before
+		loadAllSeriesMarkers();
+		markersNode = *markerstree;
+	}
+
+	snapshot.saveTree = std::move(saveTree);
+	return true;
+}
+
+void OctMarkerIO::writeSnapshot(const SaveSnapshot& snapshot)
+{
+	if(snapshot.saveTree)
+		writeSaveTree(fs::path(filenameConv(snapshot.filename)), snapshot.format, *snapshot.saveTree, &snapshot.rawModules);
+}
+
+bool OctMarkerIO::copyDeferredModules(OctMarkerFileformat format) const
+{
+	// the not yet read modules are copied encoded from the loaded file into a binary file, this needs
+	// the loaded file open while it is replaced, which isn't possible on windows
+#ifdef _WIN32
+	static_cast<void>(format);
+	return false;
+#else
+	return lazyReader && lazyReader->hasDeferredSeries() && format == OctMarkerFileformat::Binary;
+#endif
+}
+
+
+bpt::ptree& OctMarkerIO::putSaveTree(bpt::ptree& saveTree)
 {
-	bpt::ptree saveTree;
 	bpt::ptree& markerTree = saveTree.put(Constants::mainNodeName, "");
 	markerTree.put("Version", Constants::version);
-    markerTree.add_child("Markers", *markerstree);
+	return markerTree.add_child("Markers", bpt::ptree());
+}
 
 
-	std::filesystem::path p(filenameConv(markersFilename));
-    io::file_descriptor_sink fs(p.generic_string());
-    io::stream<io::file_descriptor_sink> fsstream(fs);
+bool OctMarkerIO::saveMarkersPrivat(const std::string& markersFilename, OctMarkerFileformat format)
+{
+	OctMarkerBinaryIO::RawModuleSections rawModules;
+	if(copyDeferredModules(format))
+		lazyReader->readDeferredModules(rawModules);
+	else
+		loadAllSeriesMarkers();
 
+	bpt::ptree saveTree;
+	bpt::ptree& markersNode = putSaveTree(saveTree);
+	TreeLender lendMarkers(*markerstree, markersNode); // swap keeps the node addresses of rawModules
 
-	switch(format)
+	writeSaveTree(fs::path(filenameConv(markersFilename)), format, saveTree, &rawModules);
+	return true;
+}
+
+
+void OctMarkerIO::writeSaveTree(const fs::path& markersPath, OctMarkerFileformat format, const bpt::ptree& saveTree, const OctMarkerBinaryIO::RawModuleSections* rawModules)
+{
+	// a crash or a write error leaves the old marker file intact
+	fs::path tempPath = markersPath;
+	tempPath += ".tmp";
+
+	try
 	{
-		case OctMarkerFileformat::Json:
-			bpt::write_json(fsstream, saveTree);
-			break;
-		case OctMarkerFileformat::XML:
-			bpt::write_xml(fsstream, saveTree, bpt::xml_writer_make_settings<bpt::ptree::key_type>('\t', 1u));
-			break;
-		case OctMarkerFileformat::INFO:
-			bpt::write_info(fsstream, saveTree, bpt::info_writer_settings<char>('\t', 1u));
-			break;
-		case OctMarkerFileformat::Unknown:
-		case OctMarkerFileformat::Auto:
-		case OctMarkerFileformat::NoExtension:
-			return false;
+		io::file_descriptor_sink fdSink(tempPath.generic_string());
+		io::stream<io::file_descriptor_sink> fsstream(fdSink);
+
+		switch(format)
+		{
+			case OctMarkerFileformat::Json:
+				bpt::write_json(fsstream, saveTree);
+				break;
+			case OctMarkerFileformat::XML:
+				bpt::write_xml(fsstream, saveTree, bpt::xml_writer_make_settings<bpt::ptree::key_type>('\t', 1u));
+				break;
+			case OctMarkerFileformat::INFO:
+				bpt::write_info(fsstream, saveTree, bpt::info_writer_settings<char>('\t', 1u));
+				break;
+			case OctMarkerFileformat::Binary:
+				OctMarkerBinaryIO::write(fsstream, saveTree, rawModules);
+				break;
+			case OctMarkerFileformat::Unknown:
+			case OctMarkerFileformat::Auto:
+			case OctMarkerFileformat::NoExtension:
+				throw std::runtime_error("OctMarkerIO: invalid file format");
+		}
+
+		fsstream.flush();
+		if(!fsstream)
+			throw std::runtime_error("OctMarkerIO: write error in " + tempPath.generic_string());
+	}
+	catch(...)
+	{
+		std::error_code ec;
+		fs::remove(tempPath, ec);
+		throw;
 	}
 
-	return true;
+	fs::rename(tempPath, markersPath);
 }
-
@@ -20,12 +20,16 @@
 #define OCTMARKERIO_H
 
 #include<string>
+#include<memory>
 #include<filesystem>
 #include<boost/property_tree/ptree_fwd.hpp>
 
 #include<globaldefinitions.h>
 
+#include"octmarkerbinaryio.h"
+
 namespace boost{ namespace filesystem { class path; }}
+class OctMarkerBinaryLazyReader;
 
 /**
  * @ingroup Manager
@@ -41,10 +45,28 @@ class OctMarkerIO
 	
 	boost::property_tree::ptree* markerstree = nullptr;
 
+	bool lazySeriesLoading = false;
+	std::unique_ptr<OctMarkerBinaryLazyReader> lazyReader;
+
 	bool saveMarkersPrivat(const std::string& markersFilename, OctMarkerFileformat format);
+	bool resolveSaveFormat(std::string& markersFilename, OctMarkerFileformat& format) const;
+	static boost::property_tree::ptree& putSaveTree(boost::property_tree::ptree& saveTree);
+
+	static void writeSaveTree(const std::filesystem::path& markersPath, OctMarkerFileformat format, const boost::property_tree::ptree& saveTree, const OctMarkerBinaryIO::RawModuleSections* rawModules = nullptr);
+	bool copyDeferredModules(OctMarkerFileformat format) const;
 	
 public:
+	/// complete marker file content, independent of the live marker tree
+	struct SaveSnapshot
+	{
+		std::string                                        filename;
+		OctMarkerFileformat                                format = OctMarkerFileformat::Unknown;
+		std::shared_ptr<const boost::property_tree::ptree> saveTree;
+		OctMarkerBinaryIO::RawModuleSections               rawModules;  ///< not yet read modules of the loaded binary file, by node of saveTree
+	};
+
 	explicit OctMarkerIO(boost::property_tree::ptree* markerTree);
+	~OctMarkerIO();
 	
 	
 	static const char* getFileExtension(OctMarkerFileformat format);
@@ -62,7 +84,19 @@ public:
 	bool loadMarkers(const std::string&           markersFilename, OctMarkerFileformat format);
 	bool loadMarkers(const std::filesystem::path& markersPath    , OctMarkerFileformat format);
 	bool saveMarkers(const std::string&           markersFilename, OctMarkerFileformat format);
+
+	/// copy of the markers for writing in another thread, the file name is resolved like in saveDefaultMarker
+	bool createDefaultMarkerSnapshot(const std::string& octFilename, SaveSnapshot& snapshot);
+	/// writes to a temporary file which replaces the marker file on success, thread safe
+	static void writeSnapshot(const SaveSnapshot& snapshot);
 	
+	/// binary marker files: read the modules of a series on first request by loadSeriesMarkers
+	void setLazySeriesLoading(bool enable)                      { lazySeriesLoading = enable; }
+	void loadSeriesMarkers(const boost::property_tree::ptree& seriesNode);
+	void loadAllSeriesMarkers();
+	/// forget the not yet read series, needed when the marker tree is cleared
+	void dropDeferredSeries();
+
 	bool saveMarkersSeries(const std::string& markersFilename);
 	bool addMarkersSeries (const std::string& markersFilename);
 };
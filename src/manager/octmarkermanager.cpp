@@ -34,6 +34,7 @@
 #include <QMessageBox>
 
 #include <QTime>
+#include <QElapsedTimer>
 
 #include "octdatamanager.h"
 
@@ -110,13 +111,9 @@ void OctMarkerManager::chooseBScan(int bscan)
 
 	actBScan = bscan;
 
-// 	if(actBscanMarker)
-// 		actBscanMarker->setActBScan(actBScan);
-
-	// TODO bessere Implementierung (nur aktualisieren was angezeigt wird)
-	for(BscanMarkerBase* marker : bscanMarkerObj)
-		marker->setActBScan(actBScan);
-
+	// only the shown module follows directly, the other modules are synchronized in setBscanMarker
+	if(actBscanMarker)
+		actBscanMarker->syncActBScan(static_cast<std::size_t>(actBScan));
 
 	emit(newBScanShowed(series->getBScan(actBScan)));
 	emit(bscanChanged(actBScan));
@@ -156,6 +153,9 @@ void OctMarkerManager::showSeries(const std::shared_ptr<const OctData::Series>&
 	if(s)
 		extraSeriesData->loadExtraData(*s, *markerTree);
 
+	for(BscanMarkerBase* obj : bscanMarkerObj)
+		obj->invalidateSyncedBScan();
+
 
 // 	emit(newBScanShowed(series->getBScan(actBScan)));
 	emit(newSeriesShowed(s));
@@ -197,7 +197,8 @@ void OctMarkerManager::setBscanMarker(int id)
 		}
 		if(newMarker)
 		{
-// 			newMarker->setActBScan(actBScan);
+			if(series && actBScan >= 0)
+				newMarker->syncActBScan(static_cast<std::size_t>(actBScan));
 			newMarker->activate(true);
 		}
 		
@@ -245,19 +246,38 @@ void OctMarkerManager::saveMarkerStateSlot(const std::shared_ptr<const OctData::
 		return;
 
 
-	for(BscanMarkerBase* obj : bscanMarkerObj)
+	// serialization time per module, reported to the debug output
+	QString timings;
+	QElapsedTimer totalTimer;
+	totalTimer.start();
+
+	auto saveModuleState = [markerTree, &timings](auto* obj)
 	{
+		QElapsedTimer timer;
+		timer.start();
+
+		// modules without changes since they wrote or read their subtree are skipped
 		const QString& markerId = obj->getMarkerId();
+		boost::optional<bpt::ptree&> savedSubtree = markerTree->get_child_optional(markerId.toStdString());
+		if(savedSubtree && obj->isStateSavedIn(*savedSubtree))
+		{
+			timings += QString(", %1: unchanged").arg(markerId);
+			return;
+		}
+
 		bpt::ptree& subtree = PTreeHelper::get_put(*markerTree, markerId.toStdString());
 		obj->saveState(subtree);
-	}
+
+		timings += QString(", %1: %2 ms").arg(markerId).arg(static_cast<double>(timer.nsecsElapsed())/1e6, 0, 'f', 2);
+	};
+
+	for(BscanMarkerBase* obj : bscanMarkerObj)
+		saveModuleState(obj);
 
 	for(SloMarkerBase* obj : sloMarkerObj)
-	{
-		const QString& markerId = obj->getMarkerId();
-		bpt::ptree& subtree = PTreeHelper::get_put(*markerTree, markerId.toStdString());
-		obj->saveState(subtree);
-	}
+		saveModuleState(obj);
+
+	qDebug("Saving marker state took %.2f ms%s", static_cast<double>(totalTimer.nsecsElapsed())/1e6, timings.toStdString().c_str());
 }
 
 
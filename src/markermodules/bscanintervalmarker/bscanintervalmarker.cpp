@@ -81,6 +81,8 @@ BScanIntervalMarker::BScanIntervalMarker(OctMarkerManager* markerManager)
 	}
 
 	actCollection = markersCollectionsData.begin();
+
+	connect(&OctDataManager::getInstance(), &OctDataManager::seriesSLODistanceMapReady, this, &BScanIntervalMarker::sloDistanceMapReady);
 }
 
 BScanIntervalMarker::~BScanIntervalMarker()
@@ -342,6 +344,7 @@ void BScanIntervalMarker::generateSloMap()
 
 	OctDataManager& manager = OctDataManager::getInstance();
 	const SloBScanDistanceMap* distMap = manager.getSeriesSLODistanceMap();
+	sloMapPending = !distMap;
 	if(distMap && actCollectionValid())
 	{
 		SloIntervallMap tm;
@@ -521,6 +524,8 @@ void BScanIntervalMarker::newSeriesLoaded(const std::shared_ptr<const OctData::S
 	BScanIntervalPTree::parsePTree(markerTree, this);
 	stateChangedSinceLastSave = false;
 	stateChangedInActBScan    = false;
+	sloMapPending             = false;
+	savedTree                 = &markerTree;
 }
 
 
@@ -528,6 +533,7 @@ void BScanIntervalMarker::saveState(boost::property_tree::ptree& markerTree)
 {
 	BScanIntervalPTree::fillPTree(markerTree, this);
 	stateChangedSinceLastSave = false;
+	savedTree                 = &markerTree;
 }
 
 
@@ -538,6 +544,7 @@ void BScanIntervalMarker::loadState(boost::property_tree::ptree& markerTree)
 	BScanIntervalPTree::parsePTree(markerTree, this);
 	stateChangedSinceLastSave = false;
 	stateChangedInActBScan    = true;
+	savedTree                 = &markerTree;
 }
 
 
@@ -111,6 +111,8 @@ public:
 	
 	void saveState(boost::property_tree::ptree& markerTree)  override;
 	void loadState(boost::property_tree::ptree& markerTree)  override;
+	bool isStateSavedIn(const boost::property_tree::ptree& markerTree) const override
+	                                                                { return savedTree == &markerTree && !stateChangedSinceLastSave; }
 
 	void setActBScan(std::size_t bscan) override;
 	
@@ -169,6 +171,8 @@ private:
 	Marker           actMarker;
 	bool             stateChangedSinceLastSave = false;
 	bool             stateChangedInActBScan    = false;
+	bool             sloMapPending             = false; // slo map requested while the distance map was calculated
+	const boost::property_tree::ptree* savedTree = nullptr; // tree of the last saveState or loadState
 	uint8_t          transparency = 60;
 
 	QWidget* widgetPtr2WGIntevalMarker = nullptr;
@@ -201,6 +205,7 @@ private:
 
 	void generateSloMap();
 	void autoGenerateSloMap();
+	void sloDistanceMapReady()                                      { if(sloMapPending) generateSloMap(); }
 };
 
 #endif // BSCANQUALITYMARKER_H
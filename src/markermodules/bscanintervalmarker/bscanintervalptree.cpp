@@ -34,35 +34,8 @@ namespace
 {
 	bool parsePTreeMarkerCollection(const bpt::ptree& ptree, BScanIntervalMarker* markerManager, const std::string& markerCollectionInternalName, const IntervalMarker& markerCollection, BScanIntervalMarker::MarkerCollectionWork& collectionSetterHelper)
 	{
-		boost::optional<const bpt::ptree&> bscansNode = ptree.get_child_optional(markerCollectionInternalName);
-		if(!bscansNode)
-			return true; // not a true error
-
-
-		for(const std::pair<const std::string, const bpt::ptree>& bscanPair : *bscansNode)
-		{
-			if(bscanPair.first != "BScan")
-				continue;
-
-			const bpt::ptree& bscanNode = bscanPair.second;
-			boost::optional<const bpt::ptree&> idNodeOpt = bscanNode.get_child_optional("ID");
-			if(!idNodeOpt)
-				continue;
-			int bscanId = idNodeOpt->get_value<int>(-1);
-			if(bscanId == -1)
-				continue;
-
-			for(const std::pair<const std::string, const bpt::ptree>& intervallNodePair : bscanNode)
+		BScanIntervalPTree::readIntervals(ptree, markerCollectionInternalName, [&](int bscanId, int start, int end, const std::string& intervallClass)
 			{
-				if(intervallNodePair.first != "Intervall")
-					continue;
-
-				const bpt::ptree& intervallNode = intervallNodePair.second;
-
-				int         start          = intervallNode.get_child("Start").get_value<int>();
-				int         end            = intervallNode.get_child("End"  ).get_value<int>();
-				std::string intervallClass = intervallNode.get_child("Class").get_value<std::string>();
-
 				try
 				{
 					IntervalMarker::Marker marker = markerCollection.getMarkerFromString(intervallClass);
@@ -72,9 +45,7 @@ namespace
 				{
 					std::cerr << "unknown interval class " << intervallClass << " : " << r.what() << std::endl;
 				}
-
-			}
-		}
+			});
 
 		return true;
 	}
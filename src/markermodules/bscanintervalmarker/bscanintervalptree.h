@@ -20,6 +20,9 @@
 #define BSCANINTERVALLPTREE_H
 
 
+#include <string>
+#include <functional>
+
 #include <boost/property_tree/ptree_fwd.hpp>
 
 class BScanIntervalMarker;
@@ -34,6 +37,12 @@ class BScanIntervalPTree
 public:
 	static bool parsePTree(const boost::property_tree::ptree& ptree,       BScanIntervalMarker* markerManager);
 	static void fillPTree (      boost::property_tree::ptree& ptree, const BScanIntervalMarker* markerManager);
+
+	/// closed interval [start, end] of a B-scan with the internal name of the marker class
+	typedef std::function<void(int bscanId, int start, int end, const std::string& markerClass)> IntervalFunc;
+
+	/// visits all intervals of a marker collection, independent of the module (bscanintervalptreereader.cpp, used by octmarker-export)
+	static void readIntervals(const boost::property_tree::ptree& ptree, const std::string& markerCollectionInternalName, const IntervalFunc& intervalFunc);
 };
 
 #endif // BSCANINTERVALLPTREE_H
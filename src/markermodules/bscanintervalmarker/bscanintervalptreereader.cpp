@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "bscanintervalptree.h"
+
+#include <boost/property_tree/ptree.hpp>
+
+
+namespace bpt = boost::property_tree;
+
+
+void BScanIntervalPTree::readIntervals(const bpt::ptree& ptree, const std::string& markerCollectionInternalName, const IntervalFunc& intervalFunc)
+{
+	boost::optional<const bpt::ptree&> bscansNode = ptree.get_child_optional(markerCollectionInternalName);
+	if(!bscansNode)
+		return;
+
+	for(const std::pair<const std::string, bpt::ptree>& bscanPair : *bscansNode)
+	{
+		if(bscanPair.first != "BScan")
+			continue;
+
+		const bpt::ptree& bscanNode = bscanPair.second;
+		boost::optional<const bpt::ptree&> idNodeOpt = bscanNode.get_child_optional("ID");
+		if(!idNodeOpt)
+			continue;
+		int bscanId = idNodeOpt->get_value<int>(-1);
+		if(bscanId == -1)
+			continue;
+
+		for(const std::pair<const std::string, bpt::ptree>& intervallNodePair : bscanNode)
+		{
+			if(intervallNodePair.first != "Intervall")
+				continue;
+
+			const bpt::ptree& intervallNode = intervallNodePair.second;
+
+			int         start          = intervallNode.get_child("Start").get_value<int>();
+			int         end            = intervallNode.get_child("End"  ).get_value<int>();
+			std::string intervallClass = intervallNode.get_child("Class").get_value<std::string>();
+
+			intervalFunc(bscanId, start, end, intervallClass);
+		}
+	}
+}
@@ -57,13 +57,13 @@ void SloIntervallMap::createMap(const SloBScanDistanceMap& distanceMap, const st
 	for(std::size_t y = 0; y < sizeY; ++y)
 	{
 		uint8_t* destPtr = sloMap->ptr<uint8_t>(static_cast<int>(y));
-		const SloBScanDistanceMap::PreCalcDataMatrix::value_type* srcPtr = distMatrix->scanLine(y);
+		std::size_t srcIndex = distMatrix->index(0, y);
 
 		for(std::size_t x = 0; x < sizeX; ++x)
 		{
-			if(srcPtr->init)
+			if(distMatrix->isInit(srcIndex))
 			{
-				const Color& c = getColor(srcPtr->bscan1.bscan, srcPtr->bscan1.ascan);
+				const Color& c = getColor(distMatrix->getBScan1(srcIndex), distMatrix->getAScan1(srcIndex));
 
 				destPtr[0] = c.b;
 				destPtr[1] = c.g;
@@ -79,7 +79,7 @@ void SloIntervallMap::createMap(const SloBScanDistanceMap& distanceMap, const st
 			}
 
 			destPtr += 4;
-			++srcPtr;
+			++srcIndex;
 		}
 	}
 }
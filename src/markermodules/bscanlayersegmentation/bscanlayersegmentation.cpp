@@ -78,6 +78,7 @@ BScanLayerSegmentation::BScanLayerSegmentation(OctMarkerManager* markerManager)
 , editMethodSpline(new EditSpline(this))
 , editMethodPen   (new EditPen   (this))
 , thicknesMapImage(new cv::Mat)
+, thicknessMap(std::make_unique<ThicknessMap>())
 {
 	name = tr("Layer Segmentation");
 	id   = "LayerSegmentation";
@@ -97,6 +98,8 @@ BScanLayerSegmentation::BScanLayerSegmentation(OctMarkerManager* markerManager)
 	connect(&ProgramOptions::layerSegActiveLineSize , &OptionInt::valueChanged  , this, &BScanLayerSegmentation::requestFullUpdate);
 	connect(&ProgramOptions::layerSegPassivLineSize , &OptionInt::valueChanged  , this, &BScanLayerSegmentation::requestFullUpdate);
 	connect(&ProgramOptions::layerSegSplinePointSize, &OptionInt::valueChanged  , this, &BScanLayerSegmentation::requestFullUpdate);
+
+	connect(&OctDataManager::getInstance(), &OctDataManager::seriesSLODistanceMapReady, this, &BScanLayerSegmentation::sloDistanceMapReady);
 }
 
 BScanLayerSegmentation::~BScanLayerSegmentation()
@@ -203,6 +206,8 @@ void BScanLayerSegmentation::newSeriesLoaded(const std::shared_ptr<const OctData
 {
 	BscanMarkerBase::newSeriesLoaded(series, ptree);
 	*thicknesMapImage = cv::Mat();
+	thicknessmapPending = false;
+	thicknessMap->resetThicknessMapCache();
 	resetMarkers(series);
 	loadState(ptree);
 }
@@ -235,6 +240,8 @@ void BScanLayerSegmentation::resetMarkers(std::size_t bscanNr)
 
 	segData.lines  = bscan->getSegmentLines();
 	segData.filled = true;
+	thicknessMap->setBScanModified(bscanNr);
+	setBScanChanged(bscanNr);
 
 	for(OctData::Segmentationlines::SegmentlineType type : OctData::Segmentationlines::getSegmentlineTypes())
 	{
@@ -332,6 +339,8 @@ void BScanLayerSegmentation::modifiedSegPart(std::size_t bscan, OctData::Segment
 		return;
 
 	lines[bscan].lineModified[static_cast<std::size_t>(segLine)] = true;
+	thicknessMap->setBScanModified(bscan);
+	setBScanChanged(bscan);
 	OctData::Segmentationlines::Segmentline& line = lines[bscan].lines.getSegmentLine(segLine);
 
 	if(line.size() <= start)
@@ -431,13 +440,13 @@ void BScanLayerSegmentation::generateThicknessmap()
 		const std::shared_ptr<const OctData::BScan> bscan = getActBScan();
 		OctDataManager& manager = OctDataManager::getInstance();
 		const SloBScanDistanceMap* distMap = manager.getSeriesSLODistanceMap();
+		thicknessmapPending = !distMap;
 		if(bscan && distMap)
 		{
 			double factor = bscan->getScaleFactor().getZ()*1000; // milli meter -> micro meter
 
-			ThicknessMap tm;
-			tm.createMap(*distMap, lines, thicknessmapConfig.upperLayer, thicknessmapConfig.lowerLayer, factor, *thicknessmapConfig.colormap);
-			*thicknesMapImage = tm.getThicknessMap();
+			thicknessMap->createMap(*distMap, lines, thicknessmapConfig.upperLayer, thicknessmapConfig.lowerLayer, factor, *thicknessmapConfig.colormap);
+			*thicknesMapImage = thicknessMap->getThicknessMap();
 			requestSloOverlayUpdate();
 
 // 			std::cout << "Creating thickness map took " << timer.elapsed() << " milliseconds" << std::endl;
@@ -544,19 +553,108 @@ void BScanLayerSegmentation::loadState(boost::property_tree::ptree& markerTree)
 {
 	SignalBlocker sb(this);
 
+	// without loaded or modified lines before, the tree holds afterwards exactly the lines saveState would write
+	bool treeInSync = true;
+	for(const BScanSegData& data : lines)
+		for(std::size_t typeId = 0; typeId < data.lineModified.size(); ++typeId)
+			if(data.lineModified[typeId] || data.lineLoaded[typeId])
+				treeInSync = false;
+
 	BscanMarkerBase::loadState(markerTree);
 	BScanLayerSegPTree::parsePTree(markerTree, this);
+	thicknessMap->resetThicknessMapCache();
+
+	savedTree       = treeInSync ? &markerTree : nullptr;
+	savedGeneration = changeGeneration;
 }
 
 void BScanLayerSegmentation::saveState(boost::property_tree::ptree& markerTree)
 {
 	BscanMarkerBase::saveState(markerTree);
 	BScanLayerSegPTree::fillPTree(markerTree, this);
+
+	savedTree       = &markerTree;
+	savedGeneration = changeGeneration;
 }
 
 bool BScanLayerSegmentation::saveSegmentation2Bin(const std::string& filename)
 {
-	return LayerSegmentationIO::saveSegmentation2Bin(*this, filename);
+	std::vector<const OctData::Segmentationlines*> bscanLines;
+	bscanLines.reserve(lines.size());
+	for(const BScanSegData& bscanData : lines)
+		bscanLines.push_back(&bscanData.lines);
+
+	return LayerSegmentationIO::saveSegmentation2Bin(bscanLines, getMaxBscanWidth(), filename);
+}
+
+void BScanLayerSegmentation::importSegmentationFromMap(const std::string& filename)
+{
+	const LayerSegmentationMap segmentationMap(filename);
+
+	LayerSegSeriesCommand::SegParts changedParts;
+	const std::size_t numBscans = std::min(lines.size(), segmentationMap.getNumBScans());
+	for(std::size_t bscanNr = 0; bscanNr < numBscans; ++bscanNr)
+	{
+		const BScanSegData& segData = lines[bscanNr];
+		for(OctData::Segmentationlines::SegmentlineType type : OctData::Segmentationlines::getSegmentlineTypes())
+		{
+			const float* mapLine = segmentationMap.getSegline(type, bscanNr);
+			if(!mapLine)
+				continue;
+
+			// NaN is a missing value in the map, the segline keeps its value there
+			const OctData::Segmentationlines::Segmentline& segline = segData.lines.getSegmentLine(type);
+			const std::size_t copyLength = std::min(segline.size(), segmentationMap.getBScanWidth());
+			std::size_t partBegin = copyLength;
+			std::size_t partEnd   = 0;
+			for(std::size_t i = 0; i < copyLength; ++i)
+			{
+				if(!std::isnan(mapLine[i]) && static_cast<double>(mapLine[i]) != segline[i])
+				{
+					partBegin = std::min(partBegin, i);
+					partEnd   = i + 1;
+				}
+			}
+			if(partBegin >= partEnd)
+				continue;
+
+			std::vector<double> values(segline.begin() + static_cast<std::ptrdiff_t>(partBegin), segline.begin() + static_cast<std::ptrdiff_t>(partEnd));
+			for(std::size_t i = partBegin; i < partEnd; ++i)
+				if(!std::isnan(mapLine[i]))
+					values[i - partBegin] = static_cast<double>(mapLine[i]);
+
+			changedParts.push_back(LayerSegSeriesCommand::SegPart{bscanNr, type, partBegin, std::move(values)});
+		}
+	}
+
+	if(changedParts.empty())
+		return;
+
+	swapSegParts(changedParts); // afterwards changedParts holds the old values for the undo step
+	addUndoCommand(new LayerSegSeriesCommand(*this, std::move(changedParts)));
+}
+
+bool BScanLayerSegmentation::swapSegParts(LayerSegSeriesCommand::SegParts& parts)
+{
+	for(const LayerSegSeriesCommand::SegPart& part : parts)
+		if(part.bscanNr >= lines.size() || part.start + part.values.size() > lines[part.bscanNr].lines.getSegmentLine(part.type).size())
+			return false;
+
+	for(LayerSegSeriesCommand::SegPart& part : parts)
+	{
+		BScanSegData& segData = lines[part.bscanNr];
+		OctData::Segmentationlines::Segmentline& segline = segData.lines.getSegmentLine(part.type);
+		std::swap_ranges(part.values.begin(), part.values.end(), segline.begin() + static_cast<std::ptrdiff_t>(part.start));
+
+		segData.lineModified[static_cast<std::size_t>(part.type)] = true;
+		thicknessMap->setBScanModified(part.bscanNr);
+		setBScanChanged(part.bscanNr);
+	}
+	changeActBScan = true;
+
+	updateEditLine();
+	requestFullUpdate();
+	return true;
 }
 
 
@@ -35,6 +35,7 @@
 
 #include<data_structure/point2d.h>
 #include "thicknessmaptemplates.h"
+#include "layersegcommand.h"
 #include<array>
 
 class QWidget;
@@ -44,6 +45,7 @@ class EditSpline;
 class EditPen;
 class Colormap;
 class ThicknessmapLegend;
+class ThicknessMap;
 
 /**
  *  @ingroup LayerSegmentation
@@ -56,7 +58,6 @@ class BScanLayerSegmentation : public BscanMarkerBase
 
 	friend class EditBase;
 	friend class BScanLayerSegPTree;
-	friend class LayerSegmentationIO;
 
 public:
 	struct BScanSegData
@@ -65,6 +66,7 @@ public:
 		std::array<bool, std::tuple_size<OctData::Segmentationlines::SegLinesTypeList>::value> lineModified;
 		std::array<bool, std::tuple_size<OctData::Segmentationlines::SegLinesTypeList>::value> lineLoaded;
 		bool filled = false;
+		std::size_t changeGeneration = 0; ///< value of BScanLayerSegmentation::changeGeneration at the last change of the lines
 	};
 
 	class ThicknessmapConfig
@@ -98,6 +100,8 @@ public:
 
 	void saveState(boost::property_tree::ptree& markerTree)  override;
 	void loadState(boost::property_tree::ptree& markerTree)  override;
+	bool isStateSavedIn(const boost::property_tree::ptree& markerTree) const override
+	                                                                { return savedTree == &markerTree && savedGeneration == changeGeneration; }
 
 
 	void setActBScan(std::size_t bscan) override;
@@ -116,6 +120,8 @@ public:
 	SegMethod getSegMethod() const;
 
 	bool saveSegmentation2Bin(const std::string& filename);
+	/// copies the values of a LayerSegmentationIO::saveSegmentation2Map file (NaN are skipped) as one undo step, throws on invalid files
+	void importSegmentationFromMap(const std::string& filename);
 	void copyAllSegLinesFromOctData();
 
 	void setIconsToSimple(int size);
@@ -125,6 +131,7 @@ public:
 
 	void modifiedSegPart(std::size_t bscan, OctData::Segmentationlines::SegmentlineType segLine, std::size_t start, const std::vector<double>& segPart)
 	                                                                { modifiedSegPart(bscan, segLine, start, segPart, true); }
+	bool swapSegParts(LayerSegSeriesCommand::SegParts& parts);
 
 	ThicknessmapConfig& getThicknessmapConfig()                     { return thicknessmapConfig; }
 	void setThicknessmapConfig(const ThicknessmapTemplates::Configuration& config);
@@ -137,6 +144,13 @@ private:
 	bool highlightLine = false;
 	OctData::Segmentationlines::SegmentlineType acthighlightLineType = OctData::Segmentationlines::SegmentlineType::ILM;
 
+	// saveState writes only the bscans changed since the last write to the same ptree
+	std::size_t changeGeneration = 0;
+	std::size_t savedGeneration  = 0;
+	const boost::property_tree::ptree* savedTree = nullptr;
+
+	void setBScanChanged(std::size_t bscanNr)                       { lines[bscanNr].changeGeneration = ++changeGeneration; }
+
 
 	void resetMarkers(const std::shared_ptr<const OctData::Series>& series);
 	void resetMarkers(std::size_t bscanNr);
@@ -156,8 +170,10 @@ private:
 	bool showSegmentationlines = true;
 	bool showThicknessmap      = true;
 	bool changeActBScan        = false;
+	bool thicknessmapPending   = false; // thickness map requested while the distance map was calculated
 
 	cv::Mat* thicknesMapImage = nullptr;
+	std::unique_ptr<ThicknessMap> thicknessMap;
 
 	void copySegLinesFromOctDataWhenNotFilled();
 	void copySegLinesFromOctDataWhenNotFilled(std::size_t bscan);
@@ -172,6 +188,8 @@ private:
 	void updateEditLine();
 
 	std::vector<double> getSegPart(const std::vector<double>& segLine, std::size_t ascanBegin, std::size_t ascanEnd);
+
+	void sloDistanceMapReady()                                      { if(thicknessmapPending) generateThicknessmap(); }
 signals:
 	void segMethodChanged();
 	void segLineIdChanged(std::size_t id);
@@ -20,17 +20,12 @@
 
 #include"bscanlayersegmentation.h"
 
-#include<sstream>
 #include<iostream>
 
 #include <boost/property_tree/ptree.hpp>
-#include <boost/lexical_cast.hpp>
 
 namespace bpt = boost::property_tree;
 
-#include<boost/spirit/include/qi.hpp>
-namespace qi = boost::spirit::qi;
-
 #include<octdata/datastruct/segmentationlines.h>
 #include <helper/ptreehelper.h>
 
@@ -46,48 +41,50 @@ namespace
 				return false;
 		return true;
 	}
-
-	template<typename T>
-	std::vector<T> fillToVector(const bpt::ptree& pt)
-	{
-		std::vector<T> r;
-
-		boost::optional<std::string> s = pt.get_value_optional<std::string>();
-		if(s)
-		{
-			std::string::const_iterator f(s->begin()), l(s->end());
-			/*bool ok = */qi::parse(f,l,qi::double_ % ' ',r);
-		}
-	    return r;
-	}
-
-	template<typename T>
-	void fillFromVector(bpt::ptree& pt, const std::vector<T>& vec)
-	{
-		pt.clear();
-
-		std::stringstream sstream;
-		for(const T& val : vec)
-			sstream << val << ' ';
-
-		pt.put_value(sstream.str());
-	}
-
 }
 
 
 void BScanLayerSegPTree::fillPTree(boost::property_tree::ptree& ptree, const BScanLayerSegmentation* markerManager)
 {
-	ptree.clear(); // TODO
+	// the tree holds the state of savedGeneration, only later changed bscans are rewritten
+	const bool updateTree = markerManager->savedTree == &ptree;
+
+	std::vector<bpt::ptree*> bscanNodes;
+	if(updateTree)
+	{
+		bscanNodes.resize(markerManager->lines.size(), nullptr);
+		for(std::pair<const std::string, bpt::ptree>& bscanPair : ptree)
+		{
+			if(bscanPair.first != "BScan")
+				continue;
+			const int bscanId = bscanPair.second.get<int>("ID", -1);
+			if(bscanId >= 0 && static_cast<std::size_t>(bscanId) < bscanNodes.size() && !bscanNodes[bscanId])
+				bscanNodes[bscanId] = &bscanPair.second;
+		}
+	}
+	else
+		ptree.clear();
 
+	std::string buffer;
 	std::size_t bscan = 0;
 	for(const BScanLayerSegmentation::BScanSegData& bscanData : markerManager->lines)
 	{
+		if(updateTree && bscanData.changeGeneration <= markerManager->savedGeneration)
+		{
+			++bscan;
+			continue;
+		}
+
 		const OctData::Segmentationlines& lines = bscanData.lines;
 
+		bpt::ptree* existingBScanNode = updateTree ? bscanNodes[bscan] : nullptr;
+		if(existingBScanNode)
+			existingBScanNode->erase("Lines");
+
 		PTreeHelper::NodeCreator bscanNode("BScan", ptree);
 		bscanNode.setId(bscan);
-		PTreeHelper::NodeCreator linesNode("Lines", bscanNode);
+		PTreeHelper::NodeCreator linesNode = existingBScanNode ? PTreeHelper::NodeCreator("Lines", *existingBScanNode)
+		                                                       : PTreeHelper::NodeCreator("Lines", bscanNode);
 
 		for(OctData::Segmentationlines::SegmentlineType type : OctData::Segmentationlines::getSegmentlineTypes())
 		{
@@ -103,7 +100,7 @@ void BScanLayerSegPTree::fillPTree(boost::property_tree::ptree& ptree, const BSc
 			if(!emptySegLine(line))
 			{
 				bpt::ptree& lineNode = PTreeHelper::get_put(linesNode.getNode(), name);
-				fillFromVector(lineNode, line);
+				writeSegline(lineNode, line, buffer);
 			}
 		}
 
@@ -114,7 +111,7 @@ void BScanLayerSegPTree::fillPTree(boost::property_tree::ptree& ptree, const BSc
 bool BScanLayerSegPTree::parsePTree(const boost::property_tree::ptree& ptree, BScanLayerSegmentation* markerManager)
 {
 
-	for(const std::pair<const std::string, const bpt::ptree>& bscanPair : ptree)
+	for(const std::pair<const std::string, bpt::ptree>& bscanPair : ptree)
 	{
 		if(bscanPair.first != "BScan")
 			continue;
@@ -134,32 +131,20 @@ bool BScanLayerSegPTree::parsePTree(const boost::property_tree::ptree& ptree, BS
 
 		BScanLayerSegmentation::BScanSegData& bscanData = markerManager->lines[bscanId];
 
-		for(const std::pair<const std::string, const bpt::ptree>& segLinesNodePair : *linesNode)
+		for(const std::pair<const std::string, bpt::ptree>& segLinesNodePair : *linesNode)
 		{
 			const std::string& name = segLinesNodePair.first;
 
 			OctData::Segmentationlines::SegmentlineType actType;
-			bool found = false;
-
-			const OctData::Segmentationlines::SegLinesTypeList& seglineTypes = OctData::Segmentationlines::getSegmentlineTypes();
-			for(OctData::Segmentationlines::SegmentlineType type : seglineTypes)
-			{
-				if(OctData::Segmentationlines::getSegmentlineName(type) == name)
-				{
-					actType = type;
-					found = true;
-					break;
-				}
-			}
-
-			if(!found)
+			if(!getSeglineType(name, actType))
 			{
 				std::cerr << "unhandled segmentation line: " << name << '\n';
 				continue;
 			}
 
-			bscanData.lines.getSegmentLine(actType) = fillToVector<double>(segLinesNodePair.second);
+			parseSegline(segLinesNodePair.second, bscanData.lines.getSegmentLine(actType));
 			bscanData.lineLoaded[static_cast<std::size_t>(actType)] = true;
+			markerManager->setBScanChanged(static_cast<std::size_t>(bscanId));
 		}
 	}
 
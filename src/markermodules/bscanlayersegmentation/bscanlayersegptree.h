@@ -19,8 +19,13 @@
 #ifndef BSCANLAYERSEGPTREE_H
 #define BSCANLAYERSEGPTREE_H
 
+#include<string>
+#include<vector>
+
 #include <boost/property_tree/ptree_fwd.hpp>
 
+#include<octdata/datastruct/segmentationlines.h>
+
 class BScanLayerSegmentation;
 
 /**
@@ -33,6 +38,11 @@ class BScanLayerSegPTree
 public:
 	static bool parsePTree(const boost::property_tree::ptree& ptree,       BScanLayerSegmentation* markerManager);
 	static void fillPTree (      boost::property_tree::ptree& ptree, const BScanLayerSegmentation* markerManager);
+
+	// text form of a single segline, independent of the module (bscanlayersegptreetext.cpp, used by octmarker-export)
+	static void parseSegline  (const boost::property_tree::ptree& lineNode,       std::vector<double>& line);
+	static void writeSegline  (      boost::property_tree::ptree& lineNode, const std::vector<double>& line, std::string& buffer);
+	static bool getSeglineType(const std::string& name, OctData::Segmentationlines::SegmentlineType& type);
 };
 
 #endif // BSCANLAYERSEGPTREE_H
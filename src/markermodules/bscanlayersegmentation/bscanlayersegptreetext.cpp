@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "bscanlayersegptree.h"
+
+#include<charconv>
+
+#include <boost/property_tree/ptree.hpp>
+
+namespace bpt = boost::property_tree;
+
+
+// values separated by a single space, parsing stops at the first invalid value (old format: stream output with precision 6)
+void BScanLayerSegPTree::parseSegline(const bpt::ptree& lineNode, std::vector<double>& line)
+{
+	line.clear();
+
+	const std::string& str = lineNode.data();
+	const char* pos = str.data();
+	const char* end = str.data() + str.size();
+	while(pos < end)
+	{
+		if(*pos == '+')
+			++pos;
+
+		double value;
+		const std::from_chars_result result = std::from_chars(pos, end, value);
+		if(result.ec != std::errc())
+			break;
+		line.push_back(value);
+
+		pos = result.ptr;
+		if(pos == end || *pos != ' ')
+			break;
+		++pos;
+	}
+}
+
+// shortest representation that reads back to the same value, every value followed by a space
+void BScanLayerSegPTree::writeSegline(bpt::ptree& lineNode, const std::vector<double>& line, std::string& buffer)
+{
+	constexpr std::size_t maxValueLength = 32;
+
+	lineNode.clear();
+
+	buffer.resize(line.size()*maxValueLength);
+	char* const begin = &buffer[0];
+	char* pos = begin;
+	for(const double val : line)
+	{
+		pos = std::to_chars(pos, pos + maxValueLength - 1, val).ptr;
+		*pos++ = ' ';
+	}
+
+	lineNode.data().assign(begin, pos);
+}
+
+
+bool BScanLayerSegPTree::getSeglineType(const std::string& name, OctData::Segmentationlines::SegmentlineType& type)
+{
+	for(OctData::Segmentationlines::SegmentlineType actType : OctData::Segmentationlines::getSegmentlineTypes())
+	{
+		if(OctData::Segmentationlines::getSegmentlineName(actType) == name)
+		{
+			type = actType;
+			return true;
+		}
+	}
+	return false;
+}
@@ -19,9 +19,54 @@
 #pragma once
 
 #include<cstdint>
+#include<cstring>
+#include<cmath>
+#include<limits>
+#include<vector>
 
 #include<helper/convertcolorspace.h>
 
+class Colormap;
+
+/**
+ *  @ingroup LayerSegmentation
+ *  @brief Lookup table with fixed resolution for a colormap
+ *
+ *  The table covers the values [minValue - (maxValue - minValue), maxValue], smaller values get the
+ *  color of the lower limit, values greater than maxValue get the color of the last entry.
+ *  The colors are stored as BGRA pixels (CV_8UC4 layout) with alpha 255.
+ */
+class ColormapLUT
+{
+public:
+	constexpr static const std::size_t resolution = 4096;
+
+	void create(const Colormap& colormap);
+
+	/// branch free quantization, suitable for vectorized loops
+	std::size_t getIndex(double value) const
+	{
+		double pos = (value - lowValue)*scale + 0.5;
+		pos = pos < 0        ? 0        : pos;
+		pos = pos > maxIndex ? maxIndex : pos;
+		const std::size_t index = static_cast<std::size_t>(pos);
+		return value > maxValue ? resolution : index;
+	}
+
+	uint32_t getPixel(std::size_t index)                      const { return table[index]; }
+	uint32_t getPixelForValue(double value)                   const { return table[getIndex(value)]; }
+
+private:
+	constexpr static const double maxIndex = static_cast<double>(resolution - 1);
+
+	double lowValue = 0;
+	double maxValue = 0;
+	double scale    = 0;
+
+	std::vector<uint32_t> table; // resolution entries for [lowValue, maxValue] and one entry for values > maxValue
+};
+
+
 /**
  *  @ingroup LayerSegmentation
  *  @brief Basic class for thicknessmap color
@@ -29,6 +74,8 @@
  */
 class Colormap
 {
+	mutable ColormapLUT lut;
+	mutable bool        lutValid = false;
 protected:
 	double minValue = 100;
 	double maxValue = 500;
@@ -37,13 +84,39 @@ public:
 
 	virtual void getColor(double value, uint8_t& r, uint8_t& g, uint8_t& b) const = 0;
 
-	virtual void   setMaxValue(double value)                        { maxValue = value; }
+	virtual void   setMaxValue(double value)                        { maxValue = value; lutValid = false; }
 	virtual double getMaxValue() const                              { return maxValue; }
 
-	virtual void   setMinValue(double value)                        { minValue = value; }
+	virtual void   setMinValue(double value)                        { minValue = value; lutValid = false; }
 	virtual double getMinValue() const                              { return minValue; }
+
+	/// lookup table for the actual min and max value, it is recreated after a change of the limits
+	const ColormapLUT& getLUT() const                               { if(!lutValid) { lut.create(*this); lutValid = true; } return lut; }
 };
 
+
+inline void ColormapLUT::create(const Colormap& colormap)
+{
+	maxValue = colormap.getMaxValue();
+	lowValue = colormap.getMinValue() - (maxValue - colormap.getMinValue());
+	scale    = maxValue > lowValue ? maxIndex/(maxValue - lowValue) : 0;
+
+	table.resize(resolution + 1);
+	for(std::size_t i = 0; i <= resolution; ++i)
+	{
+		double value = maxValue;
+		if(i == resolution)
+			value = std::nextafter(maxValue, std::numeric_limits<double>::infinity());
+		else if(scale > 0)
+			value = lowValue + static_cast<double>(i)/scale;
+
+		uint8_t bgra[4];
+		colormap.getColor(value, bgra[2], bgra[1], bgra[0]);
+		bgra[3] = 255;
+		std::memcpy(&table[i], bgra, sizeof(bgra));
+	}
+}
+
 /**
  *  @ingroup LayerSegmentation
  *  @brief HSV color gradient for thicknessmap
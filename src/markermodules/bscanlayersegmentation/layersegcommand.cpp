@@ -19,6 +19,7 @@
 #include "layersegcommand.h"
 
 #include<cassert>
+#include<algorithm>
 
 #include "bscanlayersegmentation.h"
 
@@ -69,3 +70,74 @@ bool LayerSegCommand::redo()
 	parent.modifiedSegPart(bscanNr, type, startPos, newPart);
 	return true;
 }
+
+std::size_t LayerSegCommand::getMemoryUsage() const
+{
+	return sizeof(*this) + (newPart.capacity() + oldPart.capacity())*sizeof(double);
+}
+
+bool LayerSegCommand::mergeWith(const MarkerCommand& next)
+{
+	const LayerSegCommand* nextCommand = dynamic_cast<const LayerSegCommand*>(&next);
+	if(!nextCommand || nextCommand->bscanNr != bscanNr || nextCommand->type != type)
+		return false;
+
+	if(newPart.size() != oldPart.size() || nextCommand->newPart.size() != nextCommand->oldPart.size())
+		return false;
+
+	// only overlapping or adjacent parts, a gap would be unknown in the merged parts
+	const std::size_t endPos     = startPos + newPart.size();
+	const std::size_t nextEndPos = nextCommand->startPos + nextCommand->newPart.size();
+	if(nextCommand->startPos > endPos || startPos > nextEndPos)
+		return false;
+
+	const std::size_t mergedStart = std::min(startPos, nextCommand->startPos);
+	const std::size_t mergedEnd   = std::max(endPos  , nextEndPos);
+	const std::ptrdiff_t offset     = static_cast<std::ptrdiff_t>(startPos              - mergedStart);
+	const std::ptrdiff_t nextOffset = static_cast<std::ptrdiff_t>(nextCommand->startPos - mergedStart);
+
+	// old: state before this command, outside of this part the next command saw the same values
+	std::vector<double> mergedOld(mergedEnd - mergedStart);
+	std::copy(nextCommand->oldPart.begin(), nextCommand->oldPart.end(), mergedOld.begin() + nextOffset);
+	std::copy(oldPart.begin()             , oldPart.end()             , mergedOld.begin() + offset);
+
+	// new: state after the next command
+	std::vector<double> mergedNew(mergedEnd - mergedStart);
+	std::copy(newPart.begin()             , newPart.end()             , mergedNew.begin() + offset);
+	std::copy(nextCommand->newPart.begin(), nextCommand->newPart.end(), mergedNew.begin() + nextOffset);
+
+	oldPart  = std::move(mergedOld);
+	newPart  = std::move(mergedNew);
+	startPos = mergedStart;
+	return true;
+}
+
+
+
+LayerSegSeriesCommand::LayerSegSeriesCommand(BScanLayerSegmentation& parent, SegParts&& parts)
+: parent(parent)
+, parts(std::move(parts))
+{
+}
+
+void LayerSegSeriesCommand::apply()
+{
+}
+
+bool LayerSegSeriesCommand::undo()
+{
+	return parent.swapSegParts(parts);
+}
+
+bool LayerSegSeriesCommand::redo()
+{
+	return parent.swapSegParts(parts);
+}
+
+std::size_t LayerSegSeriesCommand::getMemoryUsage() const
+{
+	std::size_t memory = sizeof(*this) + parts.capacity()*sizeof(SegPart);
+	for(const SegPart& part : parts)
+		memory += part.values.capacity()*sizeof(double);
+	return memory;
+}
@@ -19,6 +19,8 @@
 #ifndef LAYERSEGCOMMAND_H
 #define LAYERSEGCOMMAND_H
 
+#include<vector>
+
 #include<markermodules/markercommand.h>
 #include<octdata/datastruct/segmentationlines.h>
 
@@ -51,6 +53,44 @@ public:
 	void apply() override;
 	bool undo()  override;
 	bool redo()  override;
+
+	std::size_t getMemoryUsage() const override;
+	bool mergeWith(const MarkerCommand& next) override;
+};
+
+
+/**
+ *  @ingroup LayerSegmentation
+ *  @brief Undo and redo of a segline change in several B-scans (e.g. an import)
+ *
+ *  Holds the changed part of each segline, undo and redo swap them with the seglines of the series.
+ */
+class LayerSegSeriesCommand : public MarkerCommand
+{
+public:
+	struct SegPart
+	{
+		std::size_t bscanNr;
+		OctData::Segmentationlines::SegmentlineType type;
+		std::size_t start;
+		std::vector<double> values;
+	};
+	typedef std::vector<SegPart> SegParts;
+
+	LayerSegSeriesCommand(BScanLayerSegmentation& parent, SegParts&& parts);
+
+	LayerSegSeriesCommand(const LayerSegSeriesCommand& other)            = delete;
+	LayerSegSeriesCommand& operator=(const LayerSegSeriesCommand& other) = delete;
+
+	void apply() override;
+	bool undo()  override;
+	bool redo()  override;
+
+	std::size_t getMemoryUsage() const override;
+
+private:
+	BScanLayerSegmentation& parent;
+	SegParts parts;
 };
 
 #endif // LAYERSEGCOMMAND_H
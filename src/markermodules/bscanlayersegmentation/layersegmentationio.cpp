@@ -18,7 +18,13 @@
 
 #include "layersegmentationio.h"
 
-#include"bscanlayersegmentation.h"
+#include<limits>
+#include<algorithm>
+#include<cstring>
+#include<cstdint>
+#include<stdexcept>
+
+#include <boost/iostreams/device/mapped_file.hpp>
 
 #include <oct_cpp_framework/cvmat/cvmattreestruct.h>
 #include <oct_cpp_framework/cvmat/treestructbin.h>
@@ -26,50 +32,171 @@
 #include<opencv2/opencv.hpp>
 
 
-bool LayerSegmentationIO::saveSegmentation2Bin(const BScanLayerSegmentation& marker, const std::string& filename)
+namespace
 {
+	namespace MapLayout
+	{
+		const char        magic[8]    = { 'O', 'C', 'T', 'S', 'E', 'G', 'M', 'P' };
+		const uint32_t    version     = 1;
+		const std::size_t headerSize  = 32;
+		const std::size_t nameLength  = 48;
+		const std::size_t entrySize   = nameLength + 8;
+		const std::size_t planeAlign  = 64;
+	}
+
+	bool isLittleEndian()
+	{
+		const uint16_t value = 1;
+		uint8_t firstByte;
+		std::memcpy(&firstByte, &value, 1);
+		return firstByte == 1;
+	}
 
-	const std::vector<BScanLayerSegmentation::BScanSegData>& lines = marker.lines;
+	template<typename T>
+	void writeValue(char* pos, T value)                             { std::memcpy(pos, &value, sizeof(T)); }
 
-	const int numBscans     = static_cast<int>(lines.size()             );
-	const int maxBscanWidth = static_cast<int>(marker.getMaxBscanWidth());
+	template<typename T>
+	T readValue(const char* pos)                                    { T value; std::memcpy(&value, pos, sizeof(T)); return value; }
+
+	std::size_t alignPlane(std::size_t offset)                      { return (offset + MapLayout::planeAlign - 1)/MapLayout::planeAlign*MapLayout::planeAlign; }
+}
 
-	std::map<const char*, cv::Mat> segmentationMats;
 
+void LayerSegmentationIO::fillSegmentationTree(CppFW::CVMatTree& tree, const std::vector<const OctData::Segmentationlines*>& lines, std::size_t bscanWidth)
+{
+	const int numBscans     = static_cast<int>(lines.size());
+	const int maxBscanWidth = static_cast<int>(bscanWidth  );
 
-	// create matrizen
 	for(OctData::Segmentationlines::SegmentlineType type : OctData::Segmentationlines::getSegmentlineTypes())
 	{
 		const char* name = OctData::Segmentationlines::getSegmentlineName(type);
-		segmentationMats[name].create(numBscans, maxBscanWidth, cv::DataType<float>::type);
-	}
-
-	// fill matrizen
-	int bscan = 0;
-	for(const BScanLayerSegmentation::BScanSegData& bscanData : lines)
-	{
-		const OctData::Segmentationlines& lines = bscanData.lines;
+		cv::Mat& segmentationMat = tree.getDirNode(name).getMat();
+		segmentationMat.create(numBscans, maxBscanWidth, cv::DataType<float>::type);
+		segmentationMat = cv::Scalar(std::numeric_limits<float>::quiet_NaN());
 
-		for(OctData::Segmentationlines::SegmentlineType type : OctData::Segmentationlines::getSegmentlineTypes())
+		int bscan = 0;
+		for(const OctData::Segmentationlines* bscanLines : lines)
 		{
-			const char* name = OctData::Segmentationlines::getSegmentlineName(type);
-			const OctData::Segmentationlines::Segmentline& line = lines.getSegmentLine(type);
-			float* ptr = segmentationMats[name].ptr<float>(bscan);
-
-			std::copy(line.begin(), line.end(), ptr);
+			if(bscanLines)
+			{
+				const OctData::Segmentationlines::Segmentline& line = bscanLines->getSegmentLine(type);
+				const std::size_t copyLength = std::min(line.size(), bscanWidth);
+				std::copy(line.begin(), line.begin() + static_cast<std::ptrdiff_t>(copyLength), segmentationMat.ptr<float>(bscan));
+			}
+			++bscan;
 		}
-
-		++bscan;
 	}
+}
+
 
-	// create matrizen
+bool LayerSegmentationIO::saveSegmentation2Bin(const std::vector<const OctData::Segmentationlines*>& lines, std::size_t bscanWidth, const std::string& filename)
+{
 	CppFW::CVMatTree tree;
-	for(OctData::Segmentationlines::SegmentlineType type : OctData::Segmentationlines::getSegmentlineTypes())
+	fillSegmentationTree(tree, lines, bscanWidth);
+	return CppFW::CVMatTreeStructBin::writeBin(filename, tree);
+}
+
+
+bool LayerSegmentationIO::saveSegmentation2Map(const std::vector<const OctData::Segmentationlines*>& lines, std::size_t bscanWidth, const std::string& filename)
+{
+	if(!isLittleEndian())
+		return false;
+
+	const OctData::Segmentationlines::SegLinesTypeList& types = OctData::Segmentationlines::getSegmentlineTypes();
+	const std::size_t numPlanes  = types.size();
+	const std::size_t planeSize  = lines.size()*bscanWidth*sizeof(float);
+	const std::size_t firstPlane = alignPlane(MapLayout::headerSize + numPlanes*MapLayout::entrySize);
+	const std::size_t planeStep  = alignPlane(planeSize);
+
+	boost::iostreams::mapped_file_params params(filename);
+	params.new_file_size = static_cast<boost::iostreams::stream_offset>(std::max<std::size_t>(firstPlane + numPlanes*planeStep, 1));
+	boost::iostreams::mapped_file_sink file(params);
+	char* const data = file.data();
+	if(!data)
+		return false;
+
+	std::memset(data, 0, firstPlane);
+	std::memcpy(data, MapLayout::magic, sizeof(MapLayout::magic));
+	writeValue<uint32_t>(data +  8, MapLayout::version);
+	writeValue<uint32_t>(data + 12, static_cast<uint32_t>(numPlanes));
+	writeValue<uint64_t>(data + 16, lines.size());
+	writeValue<uint64_t>(data + 24, bscanWidth);
+
+	std::size_t planeNr = 0;
+	for(OctData::Segmentationlines::SegmentlineType type : types)
 	{
+		const std::size_t planeOffset = firstPlane + planeNr*planeStep;
+
+		char* entry = data + MapLayout::headerSize + planeNr*MapLayout::entrySize;
 		const char* name = OctData::Segmentationlines::getSegmentlineName(type);
-		tree.getDirNode(name).getMat() = segmentationMats[name];
+		std::strncpy(entry, name, MapLayout::nameLength - 1);
+		writeValue<uint64_t>(entry + MapLayout::nameLength, planeOffset);
+
+		float* plane = reinterpret_cast<float*>(data + planeOffset);
+		for(const OctData::Segmentationlines* bscanLines : lines)
+		{
+			std::size_t copyLength = 0;
+			if(bscanLines)
+			{
+				const OctData::Segmentationlines::Segmentline& line = bscanLines->getSegmentLine(type);
+				copyLength = std::min(line.size(), bscanWidth);
+				std::copy(line.begin(), line.begin() + static_cast<std::ptrdiff_t>(copyLength), plane);
+			}
+			std::fill(plane + copyLength, plane + bscanWidth, std::numeric_limits<float>::quiet_NaN());
+			plane += bscanWidth;
+		}
+		++planeNr;
 	}
 
-	CppFW::CVMatTreeStructBin::writeBin(filename, tree);
 	return true;
 }
+
+
+LayerSegmentationMap::LayerSegmentationMap(const std::string& filename)
+: file(std::make_unique<boost::iostreams::mapped_file_source>(filename))
+{
+	if(!isLittleEndian())
+		throw std::runtime_error("LayerSegmentationMap: only supported on little endian systems");
+
+	const char* const data     = file->data();
+	const std::size_t fileSize = file->size();
+
+	if(fileSize < MapLayout::headerSize
+	|| std::memcmp(data, MapLayout::magic, sizeof(MapLayout::magic)) != 0
+	|| readValue<uint32_t>(data + 8) != MapLayout::version)
+		throw std::runtime_error("LayerSegmentationMap: no segmentation map file: " + filename);
+
+	const std::size_t numPlanes = readValue<uint32_t>(data + 12);
+	numBScans  = static_cast<std::size_t>(readValue<uint64_t>(data + 16));
+	bscanWidth = static_cast<std::size_t>(readValue<uint64_t>(data + 24));
+
+	if(numPlanes > (fileSize - MapLayout::headerSize)/MapLayout::entrySize
+	|| (bscanWidth != 0 && numBScans > fileSize/bscanWidth/sizeof(float)))
+		throw std::runtime_error("LayerSegmentationMap: invalid header: " + filename);
+
+	const std::size_t planeSize = numBScans*bscanWidth*sizeof(float);
+	for(std::size_t planeNr = 0; planeNr < numPlanes; ++planeNr)
+	{
+		const char* entry = data + MapLayout::headerSize + planeNr*MapLayout::entrySize;
+		const std::string name(entry, std::find(entry, entry + MapLayout::nameLength, '\0'));
+		const uint64_t planeOffset = readValue<uint64_t>(entry + MapLayout::nameLength);
+
+		if(planeOffset%alignof(float) != 0 || planeOffset > fileSize || fileSize - planeOffset < planeSize)
+			throw std::runtime_error("LayerSegmentationMap: invalid plane offset: " + filename);
+
+		for(OctData::Segmentationlines::SegmentlineType type : OctData::Segmentationlines::getSegmentlineTypes())
+			if(name == OctData::Segmentationlines::getSegmentlineName(type))
+				planes.at(static_cast<std::size_t>(type)) = reinterpret_cast<const float*>(data + planeOffset);
+	}
+}
+
+LayerSegmentationMap::~LayerSegmentationMap() = default;
+
+
+const float* LayerSegmentationMap::getSegline(OctData::Segmentationlines::SegmentlineType type, std::size_t bscan) const
+{
+	const std::size_t typeId = static_cast<std::size_t>(type);
+	if(typeId >= planes.size() || !planes[typeId] || bscan >= numBScans)
+		return nullptr;
+	return planes[typeId] + bscan*bscanWidth;
+}
@@ -20,8 +20,14 @@
 #define LAYERSEGMENTATIONIO_H
 
 #include<string>
+#include<vector>
+#include<memory>
+#include<array>
 
-class BScanLayerSegmentation;
+#include<octdata/datastruct/segmentationlines.h>
+
+namespace CppFW   { class CVMatTree; }
+namespace boost { namespace iostreams { class mapped_file_source; } }
 
 /**
  *  @ingroup LayerSegmentation
@@ -32,7 +38,47 @@ class BScanLayerSegmentation;
 class LayerSegmentationIO
 {
 public:
-	static bool saveSegmentation2Bin(const BScanLayerSegmentation& marker, const std::string& filename);
+	/// one float mat [B-scans x bscanWidth] per segline type, missing values (also B-scans with nullptr) are NaN
+	static void fillSegmentationTree(CppFW::CVMatTree& tree, const std::vector<const OctData::Segmentationlines*>& lines, std::size_t bscanWidth);
+	static bool saveSegmentation2Bin(const std::vector<const OctData::Segmentationlines*>& lines, std::size_t bscanWidth, const std::string& filename);
+
+	/**
+	 * memory mappable layout (little endian), read by LayerSegmentationMap
+	 *
+	 * header: magic "OCTSEGMP", uint32 version, uint32 number of planes, uint64 B-scans, uint64 B-scan width
+	 * plane table: per plane 48 byte segline name (zero padded) and uint64 file offset
+	 * planes: float [B-scans x bscanWidth] per segline type, 64 byte aligned, missing values are NaN
+	 */
+	static bool saveSegmentation2Map(const std::vector<const OctData::Segmentationlines*>& lines, std::size_t bscanWidth, const std::string& filename);
+};
+
+
+/**
+ *  @ingroup LayerSegmentation
+ *  @brief Zero copy view on a file written by LayerSegmentationIO::saveSegmentation2Map
+ */
+class LayerSegmentationMap
+{
+public:
+	/// throws std::runtime_error for files in a wrong format
+	explicit LayerSegmentationMap(const std::string& filename);
+	~LayerSegmentationMap();
+
+	LayerSegmentationMap(const LayerSegmentationMap&) = delete;
+	LayerSegmentationMap& operator=(const LayerSegmentationMap&) = delete;
+
+	std::size_t getNumBScans  () const                              { return numBScans;  }
+	std::size_t getBScanWidth () const                              { return bscanWidth; }
+
+	/// getBScanWidth() values of the B-scan in the mapping, nullptr if the segline type is not in the file
+	const float* getSegline(OctData::Segmentationlines::SegmentlineType type, std::size_t bscan) const;
+
+private:
+	std::unique_ptr<boost::iostreams::mapped_file_source> file;
+
+	std::size_t numBScans  = 0;
+	std::size_t bscanWidth = 0;
+	std::array<const float*, std::tuple_size<OctData::Segmentationlines::SegLinesTypeList>::value> planes {}; // index: segline type
 };
 
 #endif // LAYERSEGMENTATIONIO_H
@@ -23,6 +23,7 @@
 #include<map>
 #include<limits>
 #include<cmath>
+#include<cstring>
 
 #include<opencv2/opencv.hpp>
 
@@ -53,6 +54,19 @@ ThicknessMap::ThicknessMap()
 
 ThicknessMap::~ThicknessMap() = default;
 
+bool ThicknessMap::MapParameter::operator==(const MapParameter& other) const
+{
+	return distanceMap == other.distanceMap
+	    && t1          == other.t1
+	    && t2          == other.t2
+	    && scaleFactor == other.scaleFactor
+	    && colormap    == other.colormap
+	    && colormapMin == other.colormapMin
+	    && colormapMax == other.colormapMax
+	    && blendColor  == other.blendColor;
+}
+
+
 void ThicknessMap::createMap(const SloBScanDistanceMap& distMap
                            , const std::vector<BScanLayerSegmentation::BScanSegData>& lines
                            , OctData::Segmentationlines::SegmentlineType t1
@@ -65,91 +79,240 @@ void ThicknessMap::createMap(const SloBScanDistanceMap& distMap
 	if(!distMatrix)
 		return;
 
-	bool blendColor = ProgramOptions::layerSegThicknessmapBlend();
+	MapParameter parameter;
+	parameter.distanceMap = &distMap;
+	parameter.t1          = t1;
+	parameter.t2          = t2;
+	parameter.scaleFactor = scaleFactor;
+	parameter.colormap    = &colormap;
+	parameter.colormapMin = colormap.getMinValue();
+	parameter.colormapMax = colormap.getMaxValue();
+	parameter.blendColor  = ProgramOptions::layerSegThicknessmapBlend();
+
+	const bool sizeChanged = thicknessMap->rows != static_cast<int>(distMatrix->getSizeY())
+	                      || thicknessMap->cols != static_cast<int>(distMatrix->getSizeX())
+	                      || thicknessMatrix.getSizeY() != lines.size();
+
+	if(!fullUpdate)
+		fullUpdate = modifiedBScanExceedsMatrix(lines, t1, t2);
+
+	if(fullUpdate || sizeChanged || parameter != actParameter)
+	{
+		fillLineVec(lines, t1, t2);
+		createBScanPixelIndex(*distMatrix);
+		createFullMap(*distMatrix, parameter);
+	}
+	else
+		updateModifiedMap(*distMatrix, parameter, lines);
+
+	actParameter = parameter;
+	fullUpdate   = false;
+	modifiedBScans.assign(lines.size(), false);
+}
 
-	const std::size_t sizeX = distMatrix->getSizeX();
-	const std::size_t sizeY = distMatrix->getSizeY();
 
-	fillLineVec(lines, t1, t2);
+void ThicknessMap::createFullMap(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, const MapParameter& parameter)
+{
+	const std::size_t sizeX = distMatrix.getSizeX();
+	const std::size_t sizeY = distMatrix.getSizeY();
 
 	thicknessMap->create(static_cast<int>(sizeY), static_cast<int>(sizeX), CV_8UC4);
 
+	const ColormapLUT& lut = parameter.colormap->getLUT();
+
 	for(std::size_t y = 0; y < sizeY; ++y)
 	{
-		uint8_t* destPtr = thicknessMap->ptr<uint8_t>(static_cast<int>(y));
-		const SloBScanDistanceMap::PreCalcDataMatrix::value_type* srcPtr = distMatrix->scanLine(y);
+		calcRowValues(distMatrix, distMatrix.index(0, y), sizeX, parameter.blendColor);
+		colorizeRow(sizeX, parameter.scaleFactor, lut, thicknessMap->ptr<uint8_t>(static_cast<int>(y)));
+	}
+}
 
-		for(std::size_t x = 0; x < sizeX; ++x)
-		{
-			if(srcPtr->init)
-			{
-				double value;
-				if(blendColor) value = getMixValue(*srcPtr);
-				else           value = getSingleValue(*srcPtr);
-
-				if(value < 0.)
-				{
-					destPtr[0] = 0;
-					destPtr[1] = 0;
-					destPtr[2] = 0;
-					destPtr[3] = 0;
-				}
-				else
-				{
-					double mixThickness = value*scaleFactor;
 
-					colormap.getColor(mixThickness, destPtr[2], destPtr[1], destPtr[0]);
-					destPtr[3] = 255;
-				}
+/**
+ * Calculate the thickness values of a SLO row in rowValues, negative values for pixels without a thickness.
+ * The gather from the thickness matrix is separated from the arithmetic,
+ * so the mixing loop works on plain arrays without branches and can be vectorized by the compiler.
+ */
+void ThicknessMap::calcRowValues(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, std::size_t startIndex, std::size_t length, bool blendColor)
+{
+	rowHeight1.resize(length);
+	rowValues .resize(length);
 
-			}
-			else
-			{
-				destPtr[0] = 0;
-				destPtr[1] = 0;
-				destPtr[2] = 0;
-				destPtr[3] = 0;
-			}
+	constexpr const double nan = std::numeric_limits<double>::quiet_NaN();
+
+	double* const h1Ptr     = rowHeight1.data();
+	double* const valuesPtr = rowValues .data();
+
+	for(std::size_t i = 0; i < length; ++i)
+	{
+		const std::size_t index = startIndex + i;
+		h1Ptr[i] = distMatrix.isInit(index) ? getValue(distMatrix.getBScan1(index), distMatrix.getAScan1(index)) : nan;
+	}
+
+	if(!blendColor)
+	{
+		for(std::size_t i = 0; i < length; ++i)
+			valuesPtr[i] = std::isnan(h1Ptr[i]) ? -1. : h1Ptr[i];
+		return;
+	}
+
+	rowHeight2.resize(length);
+	double* const h2Ptr = rowHeight2.data();
+
+	for(std::size_t i = 0; i < length; ++i)
+	{
+		const std::size_t index = startIndex + i;
+		h2Ptr[i] = distMatrix.isInit(index) ? getValue(distMatrix.getBScan2(index), distMatrix.getAScan2(index)) : nan;
+	}
+
+	// same result as getMixValue
+	const float* const distance1Ptr = distMatrix.getDistance1Data() + startIndex;
+	const float* const distance2Ptr = distMatrix.getDistance2Data() + startIndex;
+	for(std::size_t i = 0; i < length; ++i)
+	{
+		const double h1        = h1Ptr[i];
+		const double h2        = h2Ptr[i];
+		const double distance1 = distance1Ptr[i];
+		const double distance2 = distance2Ptr[i];
+		const double l         = distance1 + distance2;
+
+		const double mix    = h1*(distance2/l) + h2*(distance1/l);
+		const bool   onlyH1 = (distance1 == 0) | !(h2 >= 0) | (l == 0);
+
+		valuesPtr[i] = (h1 >= 0) ? (onlyH1 ? h1 : mix) : -1.;
+	}
+}
+
+
+void ThicknessMap::colorizeRow(std::size_t length, double scaleFactor, const ColormapLUT& lut, uint8_t* destPtr) const
+{
+	const double* const valuesPtr = rowValues.data();
 
-			destPtr += 4;
-			++srcPtr;
+	for(std::size_t i = 0; i < length; ++i)
+	{
+		const double value = valuesPtr[i];
+		const uint32_t pixel = value >= 0. ? lut.getPixelForValue(value*scaleFactor) : 0;
+		std::memcpy(destPtr + i*4, &pixel, sizeof(pixel));
+	}
+}
+
+
+void ThicknessMap::updateModifiedMap(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, const MapParameter& parameter, const std::vector<BScanLayerSegmentation::BScanSegData>& lines)
+{
+	const std::size_t numBScans = std::min(modifiedBScans.size(), lines.size());
+	const std::size_t sizeX     = distMatrix.getSizeX();
+
+	for(std::size_t bscan = 0; bscan < numBScans; ++bscan)
+		if(modifiedBScans[bscan])
+			fillThicknessBscan(lines[bscan], bscan, parameter.t1, parameter.t2);
+
+	for(std::size_t bscan = 0; bscan < numBScans && bscan+1 < bscanPixelsOffset.size(); ++bscan)
+	{
+		if(!modifiedBScans[bscan])
+			continue;
+
+		for(std::size_t i = bscanPixelsOffset[bscan]; i < bscanPixelsOffset[bscan+1]; ++i)
+		{
+			const std::size_t srcIndex = bscanPixels[i];
+			const std::size_t x = srcIndex % sizeX;
+			const std::size_t y = srcIndex / sizeX;
+
+			uint8_t* destPtr = thicknessMap->ptr<uint8_t>(static_cast<int>(y)) + x*4;
+			setPixelColor(distMatrix, parameter, srcIndex, destPtr);
 		}
+	}
+}
+
+
+void ThicknessMap::createBScanPixelIndex(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix)
+{
+	const std::size_t numBScans = thicknessMatrix.getSizeY();
+	const std::size_t numPixels = distMatrix.getSizeX()*distMatrix.getSizeY();
 
+	// counting sort: count the pixels per b-scan, then fill the pixel indices
+	bscanPixelsOffset.assign(numBScans + 1, 0);
+	auto countPixel = [&](std::size_t bscan) { if(bscan < numBScans) ++bscanPixelsOffset[bscan+1]; };
+	for(std::size_t i = 0; i < numPixels; ++i)
+	{
+		if(!distMatrix.isInit(i))
+			continue;
+
+		const std::size_t bscan1 = distMatrix.getBScan1(i);
+		const std::size_t bscan2 = distMatrix.getBScan2(i);
+		countPixel(bscan1);
+		if(bscan2 != bscan1)
+			countPixel(bscan2);
+	}
+
+	for(std::size_t bscan = 0; bscan < numBScans; ++bscan)
+		bscanPixelsOffset[bscan+1] += bscanPixelsOffset[bscan];
+
+	std::vector<std::size_t> insertPos(bscanPixelsOffset.begin(), bscanPixelsOffset.end() - 1);
+	bscanPixels.resize(bscanPixelsOffset.back());
+	auto insertPixel = [&](std::size_t bscan, std::size_t pixel) { if(bscan < numBScans) bscanPixels[insertPos[bscan]++] = static_cast<uint32_t>(pixel); };
+	for(std::size_t i = 0; i < numPixels; ++i)
+	{
+		if(!distMatrix.isInit(i))
+			continue;
+
+		const std::size_t bscan1 = distMatrix.getBScan1(i);
+		const std::size_t bscan2 = distMatrix.getBScan2(i);
+		insertPixel(bscan1, i);
+		if(bscan2 != bscan1)
+			insertPixel(bscan2, i);
 	}
 }
 
-double ThicknessMap::getSingleValue(const SloBScanDistanceMap::PixelInfo& pinfo) const
+
+inline void ThicknessMap::setPixelColor(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, const MapParameter& parameter, std::size_t index, uint8_t* destPtr) const
 {
-	const SloBScanDistanceMap::InfoBScanDist& bInfo1 = pinfo.bscan1;
-	const double height = getValue(bInfo1);
+	if(distMatrix.isInit(index))
+	{
+		double value;
+		if(parameter.blendColor) value = getMixValue   (distMatrix, index);
+		else                     value = getSingleValue(distMatrix, index);
+
+		if(value >= 0.)
+		{
+			const uint32_t pixel = parameter.colormap->getLUT().getPixelForValue(value*parameter.scaleFactor);
+			std::memcpy(destPtr, &pixel, sizeof(pixel));
+			return;
+		}
+	}
+
+	std::memset(destPtr, 0, 4);
+}
+
+double ThicknessMap::getSingleValue(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, std::size_t index) const
+{
+	const double height = getValue(distMatrix.getBScan1(index), distMatrix.getAScan1(index));
 	if(std::isnan(height))
 		return -1;
 	return height;
 }
 
 
-double ThicknessMap::getMixValue(const SloBScanDistanceMap::PixelInfo& pinfo) const
+double ThicknessMap::getMixValue(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, std::size_t index) const
 {
-	const SloBScanDistanceMap::InfoBScanDist& bInfo1 = pinfo.bscan1;
-	const SloBScanDistanceMap::InfoBScanDist& bInfo2 = pinfo.bscan2;
-
-	const double h1 = getValue(bInfo1);
+	const double h1 = getValue(distMatrix.getBScan1(index), distMatrix.getAScan1(index));
 	if(std::isnan(h1) || h1 < 0)
 		return -1;
 
-	if(bInfo1.distance == 0)
+	const double distance1 = distMatrix.getDistance1(index);
+	if(distance1 == 0)
 		return h1;
 
-	const double h2 = getValue(bInfo2);
+	const double h2 = getValue(distMatrix.getBScan2(index), distMatrix.getAScan2(index));
 	if(std::isnan(h2) || h2 < 0)
 		return h1;
 
-	const double l = bInfo1.distance + bInfo2.distance;
+	const double distance2 = distMatrix.getDistance2(index);
+	const double l = distance1 + distance2;
 	if(l == 0)
 		return h1;
 
-	const double w1 = bInfo2.distance/l;
-	const double w2 = bInfo1.distance/l;
+	const double w1 = distance2/l;
+	const double w2 = distance1/l;
 
 	const double result = h1*w1 + h2*w2;
 
@@ -157,11 +320,8 @@ double ThicknessMap::getMixValue(const SloBScanDistanceMap::PixelInfo& pinfo) co
 }
 
 
-inline double ThicknessMap::getValue(const SloBScanDistanceMap::InfoBScanDist& info) const
+inline double ThicknessMap::getValue(std::size_t bscan, std::size_t ascan) const
 {
-	const std::size_t ascan = info.ascan;
-	const std::size_t bscan = info.bscan;
-
 	if(ascan >= thicknessMatrix.getSizeX() || bscan >= thicknessMatrix.getSizeY())
 		return std::numeric_limits<double>::quiet_NaN();
 
@@ -193,6 +353,22 @@ void ThicknessMap::initThicknessMatrix(const std::vector<BScanLayerSegmentation:
 	thicknessMatrix.resize(maxAscanNum, numBscans);
 }
 
+bool ThicknessMap::modifiedBScanExceedsMatrix(const std::vector<BScanLayerSegmentation::BScanSegData>& lines, OctData::Segmentationlines::SegmentlineType t1, OctData::Segmentationlines::SegmentlineType t2) const
+{
+	const std::size_t numBScans = std::min(modifiedBScans.size(), lines.size());
+	for(std::size_t bscan = 0; bscan < numBScans; ++bscan)
+	{
+		const BScanLayerSegmentation::BScanSegData& segData = lines[bscan];
+		if(!modifiedBScans[bscan] || !segData.filled)
+			continue;
+
+		const std::size_t numAscans = std::min(segData.lines.getSegmentLine(t1).size(), segData.lines.getSegmentLine(t2).size());
+		if(numAscans > thicknessMatrix.getSizeX())
+			return true;
+	}
+	return false;
+}
+
 void ThicknessMap::fillLineVec(const std::vector<BScanLayerSegmentation::BScanSegData>& lines
                              , OctData::Segmentationlines::SegmentlineType t1
                              , OctData::Segmentationlines::SegmentlineType t2)
@@ -253,4 +429,13 @@ void ThicknessMap::fillThicknessBscan(const BScanLayerSegmentation::BScanSegData
 
 void ThicknessMap::resetThicknessMapCache()
 {
+	fullUpdate = true;
+}
+
+void ThicknessMap::setBScanModified(std::size_t bscan)
+{
+	if(bscan < modifiedBScans.size())
+		modifiedBScans[bscan] = true;
+	else
+		fullUpdate = true;
 }
@@ -31,12 +31,17 @@
 #include<octdata/datastruct/segmentationlines.h>
 
 class Colormap;
+class ColormapLUT;
 namespace cv { class Mat; }
 
 /**
  *  @ingroup LayerSegmentation
  *  @brief Creating a thicknessmap from the layer segmentation
  *
+ *  The map is hold by the layer segmentation module over several calls of createMap.
+ *  B-scans marked with setBScanModified are recalculated, only the SLO pixels which
+ *  reference such a B-scan are recolored. All other changes (distance map, layers,
+ *  scale factor, colormap, blend mode) lead to a full calculation.
  */
 class ThicknessMap
 {
@@ -49,6 +54,7 @@ public:
 	ThicknessMap& operator=(const ThicknessMap& other) = delete;
 
 	void resetThicknessMapCache();
+	void setBScanModified(std::size_t bscan);
 
 
 	void createMap(const SloBScanDistanceMap& distanceMap
@@ -61,11 +67,49 @@ public:
 	const cv::Mat& getThicknessMap() const { return *thicknessMap; }
 
 private:
+	/// parameters of the last createMap call, a change forces a full calculation
+	struct MapParameter
+	{
+		const SloBScanDistanceMap* distanceMap = nullptr;
+		OctData::Segmentationlines::SegmentlineType t1 = OctData::Segmentationlines::SegmentlineType::ILM;
+		OctData::Segmentationlines::SegmentlineType t2 = OctData::Segmentationlines::SegmentlineType::ILM;
+		double scaleFactor = 0;
+		const Colormap* colormap = nullptr;
+		double colormapMin = 0;
+		double colormapMax = 0;
+		bool   blendColor  = false;
+
+		bool operator==(const MapParameter& other) const;
+		bool operator!=(const MapParameter& other) const            { return !operator==(other); }
+	};
+
 	std::unique_ptr<cv::Mat> thicknessMap;
 
-	double getSingleValue(const SloBScanDistanceMap::PixelInfo& pinfo) const;
-	double getMixValue(const SloBScanDistanceMap::PixelInfo& pinfo) const;
-	double getValue(const SloBScanDistanceMap::InfoBScanDist& info) const;
+	MapParameter      actParameter;
+	bool              fullUpdate = true;
+	std::vector<bool> modifiedBScans;
+
+	/// inverse index, SLO pixels that reference a B-scan (in bscan1 or bscan2), pixels of b-scan i are in range [bscanPixelsOffset[i], bscanPixelsOffset[i+1])
+	std::vector<std::size_t> bscanPixelsOffset;
+	std::vector<uint32_t>    bscanPixels;
+
+	/// scratch buffers for the row wise calculation in createFullMap
+	std::vector<double> rowHeight1;
+	std::vector<double> rowHeight2;
+	std::vector<double> rowValues;
+
+	void createFullMap   (const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, const MapParameter& parameter);
+	void updateModifiedMap(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, const MapParameter& parameter, const std::vector<BScanLayerSegmentation::BScanSegData>& lines);
+	void createBScanPixelIndex(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix);
+
+	void calcRowValues(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, std::size_t startIndex, std::size_t length, bool blendColor);
+	void colorizeRow(std::size_t length, double scaleFactor, const ColormapLUT& lut, uint8_t* destPtr) const;
+
+	void setPixelColor(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, const MapParameter& parameter, std::size_t index, uint8_t* destPtr) const;
+
+	double getSingleValue(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, std::size_t index) const;
+	double getMixValue(const SloBScanDistanceMap::PreCalcDataMatrix& distMatrix, std::size_t index) const;
+	double getValue(std::size_t bscan, std::size_t ascan) const;
 
 	void fillLineVec(const std::vector<BScanLayerSegmentation::BScanSegData>& lines
 	               , OctData::Segmentationlines::SegmentlineType t1
@@ -80,6 +124,11 @@ private:
 	                       , OctData::Segmentationlines::SegmentlineType t1
 	                       , OctData::Segmentationlines::SegmentlineType t2);
 
+	/// true if the seglines of a modified B-scan are longer than the thickness matrix, it has to be recreated then
+	bool modifiedBScanExceedsMatrix(const std::vector<BScanLayerSegmentation::BScanSegData>& lines
+	                              , OctData::Segmentationlines::SegmentlineType t1
+	                              , OctData::Segmentationlines::SegmentlineType t2) const;
+
 	Matrix<double> thicknessMatrix;
 };
 
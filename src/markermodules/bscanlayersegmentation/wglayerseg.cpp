@@ -31,6 +31,10 @@
 #include<QLabel>
 #include<QGuiApplication>
 #include<QScreen>
+#include<QFileDialog>
+#include<QMessageBox>
+
+#include<stdexcept>
 
 #include<octdata/datastruct/segmentationlines.h>
 #include <data_structure/programoptions.h>
@@ -198,6 +202,12 @@ void WGLayerSeg::createMarkerToolButtons(QLayout& layout)
 	buttonShowSeglines = createActionToolButton(this, actionShowSeglines);
 	layoutTools->addWidget(buttonShowSeglines);
 
+	QAction* importSegmentationFromMap = new QAction(this);
+	importSegmentationFromMap->setText(tr("Import segmentation from segmap file"));
+	importSegmentationFromMap->setIcon(QIcon(":/icons/folder_image.png"));
+	connect(importSegmentationFromMap, &QAction::triggered, this, &WGLayerSeg::importSegmentationFromMapSlot);
+	layoutTools->addWidget(createActionToolButton(this, importSegmentationFromMap));
+
 	widget->setLayout(layoutTools);
 	layout.addWidget(widget);
 }
@@ -292,3 +302,19 @@ void WGLayerSeg::segLineVisibleChanged(bool v)
 	actionShowSeglines->setChecked(v);
 }
 
+void WGLayerSeg::importSegmentationFromMapSlot()
+{
+	QString file = QFileDialog::getOpenFileName(this, tr("Import segmentation from segmap file"), QString(), "*.segmap");
+	if(file.isEmpty())
+		return;
+
+	try
+	{
+		parent->importSegmentationFromMap(file.toStdString());
+	}
+	catch(const std::exception& e)
+	{
+		QMessageBox::critical(this, tr("Import segmentation from segmap file"), QString::fromStdString(e.what()));
+	}
+}
+
@@ -77,6 +77,8 @@ private slots:
 
 	void segLineIdChanged(std::size_t index);
 	void segLineVisibleChanged(bool v);
+
+	void importSegmentationFromMapSlot();
 };
 
 #endif // WGLAYERSEG_H
@@ -28,6 +28,10 @@
 
 #include <manager/octmarkermanager.h>
 #include<markermodules/markercommand.h>
+#include<helper/overlayblend.h>
+#include<data_structure/programoptions.h>
+
+#include<algorithm>
 
 std::size_t BscanMarkerBase::getActBScanNr() const
 {
@@ -82,6 +86,17 @@ std::shared_ptr<const OctData::BScan> BscanMarkerBase::getBScan(std::size_t nr)
 }
 
 
+void BscanMarkerBase::syncActBScan(std::size_t bscan)
+{
+	if(bscanSynced && syncedBScan == bscan)
+		return;
+
+	bscanSynced = true;
+	syncedBScan = bscan;
+	setActBScan(bscan);
+}
+
+
 void BscanMarkerBase::activate(bool b)
 {
 	isActivated = b;
@@ -104,39 +119,6 @@ bool BscanMarkerBase::setMarkerActive(bool active, BScanMarkerWidget*)
 }
 
 
-namespace
-{
-	template<int channels>
-	bool drawSLOOverlayImage4Datatype(const cv::Mat& sloImage, cv::Mat& outSloImage, double alpha, const cv::Mat& sloOverlay)
-	{
-		outSloImage.create(sloImage.size(), CV_8UC3);
-		const std::size_t length = static_cast<std::size_t>(sloImage.cols*sloImage.rows);
-
-		const uint8_t* thi  = sloOverlay .ptr<uint8_t>(0);
-		const uint8_t* src  =    sloImage.ptr<uint8_t>(0);
-		      uint8_t* dest = outSloImage.ptr<uint8_t>(0);
-
-		for(std::size_t i = 0; i<length; ++i)
-		{
-			uint8_t alphaThicknes = thi[3];
-			if(alphaThicknes > 0)
-			{
-				double blend = static_cast<double>(alphaThicknes)/255. * alpha;
-				for(int k = 0; k<3; ++k)
-					dest[k] = static_cast<uint8_t>(src[k % channels]*(1-blend) + thi[k]*blend);
-			}
-			else
-				for(int k = 0; k<3; ++k)
-					dest[k] = src[k % channels];
-
-			thi  += 4;
-			dest += 3;
-			src += channels;
-		}
-		return true;
-	}
-}
-
 bool BscanMarkerBase::drawSLOOverlayImage(const cv::Mat& sloImage, cv::Mat& outSloImage, double alpha, const cv::Mat& sloOverlay) const
 {
 	if(alpha == -1.)
@@ -152,18 +134,16 @@ bool BscanMarkerBase::drawSLOOverlayImage(const cv::Mat& sloImage, cv::Mat& outS
 			qDebug("%d != %d || %d != %d", sloImage.depth(), cv::DataType<uint8_t>::type, sloOverlay.type(), CV_8UC4);
 			return false;
 		}
-		switch(sloImage.channels())
+		if(sloImage.channels() != 1 && sloImage.channels() != 3)
 		{
-			case 1:
-				drawSLOOverlayImage4Datatype<1>(sloImage, outSloImage, alpha, sloOverlay);
-				return true;
-			case 3:
-				drawSLOOverlayImage4Datatype<3>(sloImage, outSloImage, alpha, sloOverlay);
-				return true;
-			default:
-				qDebug("Unsupported number of channels: %d", sloImage.channels());
-				return false;
+			qDebug("Unsupported number of channels: %d", sloImage.channels());
+			return false;
 		}
+
+		outSloImage.create(sloImage.size(), CV_8UC3);
+		for(int row = 0; row < sloImage.rows; ++row)
+			OverlayBlend::blendBGRA(sloImage.ptr<uint8_t>(row), sloImage.channels(), sloOverlay.ptr<uint8_t>(row), outSloImage.ptr<uint8_t>(row), static_cast<std::size_t>(sloImage.cols), alpha);
+		return true;
 	}
 	return false;
 }
@@ -174,11 +154,48 @@ bool BscanMarkerBase::drawSLOOverlayImage(const cv::Mat& sloImage, cv::Mat& outS
 void BscanMarkerBase::addUndoCommand(MarkerCommand* command)
 {
 	clearRedo();
-	undoList.push_back(command);
 
+	MarkerCommand* lastCommand = undoList.empty() ? nullptr : undoList.back();
+	const std::size_t lastMemory = lastCommand ? lastCommand->getMemoryUsage() : 0;
+	if(lastCommand && lastCommand->getBScan() == command->getBScan() && lastCommand->mergeWith(*command))
+	{
+		undoRedoMemory = undoRedoMemory - lastMemory + lastCommand->getMemoryUsage();
+		delete command;
+	}
+	else
+	{
+		undoList.push_back(command);
+		undoRedoMemory += command->getMemoryUsage();
+	}
+
+	// remove the oldest steps, the last step is always kept
+	const std::size_t budget = getUndoMemoryBudget();
+	std::size_t removeSteps = 0;
+	while(undoRedoMemory > budget && removeSteps + 1 < undoList.size())
+	{
+		undoRedoMemory -= undoList[removeSteps]->getMemoryUsage();
+		delete undoList[removeSteps];
+		++removeSteps;
+	}
+	undoList.erase(undoList.begin(), undoList.begin() + static_cast<std::ptrdiff_t>(removeSteps));
+
+	reportUndoMemoryUsage(removeSteps);
 	undoRedoChanged();
 }
 
+std::size_t BscanMarkerBase::getUndoMemoryBudget() const
+{
+	return static_cast<std::size_t>(std::max(0, ProgramOptions::undoMemoryBudgetMiB()))*1024*1024;
+}
+
+void BscanMarkerBase::reportUndoMemoryUsage(std::size_t removedSteps) const
+{
+	if(removedSteps > 0)
+		qDebug("%s: undo history %zu steps, %.1f KiB, removed %zu old steps (budget %d MiB)", id.toStdString().c_str(), undoList.size(), static_cast<double>(undoRedoMemory)/1024., removedSteps, ProgramOptions::undoMemoryBudgetMiB());
+	else
+		qDebug("%s: undo history %zu steps, %.1f KiB", id.toStdString().c_str(), undoList.size(), static_cast<double>(undoRedoMemory)/1024.);
+}
+
 void BscanMarkerBase::callRedoStep()
 {
 	if(redoList.size() == 0)
@@ -188,8 +205,10 @@ void BscanMarkerBase::callRedoStep()
 	if(!checkBScan(command))
 		return;
 
+	const std::size_t commandMemory = command->getMemoryUsage();
 	if(!command->redo())
 		return;
+	undoRedoMemory = undoRedoMemory - commandMemory + command->getMemoryUsage(); // a swapped state can differ in size
 
 	undoList.push_back(command);
 	redoList.pop_back();
@@ -206,8 +225,10 @@ void BscanMarkerBase::callUndoStep()
 	if(!checkBScan(command))
 		return;
 
+	const std::size_t commandMemory = command->getMemoryUsage();
 	if(!command->undo())
 		return;
+	undoRedoMemory = undoRedoMemory - commandMemory + command->getMemoryUsage();
 
 	redoList.push_back(command);
 	undoList.pop_back();
@@ -221,6 +242,7 @@ void BscanMarkerBase::clearUndoRedo()
 	for(MarkerCommand* command : undoList)
 		delete command;
 	undoList.clear();
+	undoRedoMemory = 0;
 
 	undoRedoChanged();
 }
@@ -228,7 +250,10 @@ void BscanMarkerBase::clearUndoRedo()
 void BscanMarkerBase::clearRedo()
 {
 	for(MarkerCommand* command : redoList)
+	{
+		undoRedoMemory -= command->getMemoryUsage();
 		delete command;
+	}
 	redoList.clear();
 }
 
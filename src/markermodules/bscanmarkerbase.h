@@ -111,16 +111,24 @@ public:
 	virtual void activate(bool);
 	virtual void saveState(boost::property_tree::ptree&)            {}
 	virtual void loadState(boost::property_tree::ptree&)            { clearUndoRedo(); }
+	/// true if the last saveState or loadState used this tree and the state has not changed since, saveState can be skipped
+	virtual bool isStateSavedIn(const boost::property_tree::ptree&) const
+	                                                                { return false; }
 	
 	virtual void newSeriesLoaded(const std::shared_ptr<const OctData::Series>&, boost::property_tree::ptree&)
 	                                                                { clearUndoRedo(); }
 
 	std::size_t numUndoSteps()                                const { return undoList.size(); }
 	std::size_t numRedoSteps()                                const { return redoList.size(); }
+	std::size_t undoRedoMemoryUsage()                         const { return undoRedoMemory; }
 
 
 	std::size_t getActBScanNr() const;
 
+	/// calls setActBScan only when the module shows another b-scan, inactive modules are synchronized on activation
+	void syncActBScan(std::size_t bscan);
+	void invalidateSyncedBScan()                                    { bscanSynced = false; }
+
 public slots:
 	void callRedoStep();
 	void callUndoStep();
@@ -149,6 +157,8 @@ protected:
 
 	void addUndoCommand(MarkerCommand* command);
 	void clearUndoRedo();
+	/// the oldest undo steps are removed when the undo and redo steps need more memory
+	virtual std::size_t getUndoMemoryBudget() const;
 	
 	QString name;
 	QString id;
@@ -159,8 +169,15 @@ protected:
 	std::vector<MarkerCommand*> undoList;
 	std::vector<MarkerCommand*> redoList;
 
+private:
+	std::size_t undoRedoMemory = 0;
+
+	bool        bscanSynced = false;
+	std::size_t syncedBScan = 0;
+
 private:
 	void clearRedo();
 	bool checkBScan(MarkerCommand* command);
+	void reportUndoMemoryUsage(std::size_t removedSteps) const;
 };
 
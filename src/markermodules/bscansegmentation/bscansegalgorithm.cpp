@@ -25,6 +25,7 @@
 #include <cassert>
 #include <limits>
 #include <cmath>
+#include <algorithm>
 
 
 #include <octdata/datastruct/bscan.h>
@@ -32,8 +33,107 @@
 
 #include "bscansegmentation.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define BSCANSEGALGORITHM_SSE2
+	#include<emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+	#define BSCANSEGALGORITHM_AVX2
+	#include<immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+	#include<intrin.h>
+#endif
+
 namespace
 {
+	inline int countTrailingZeros(uint32_t mask)
+	{
+		assert(mask != 0);
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	/**
+	 * helper for the column blocked threshold direction kernel,
+	 * a block are blockCols adjacent columns of a row major cv::Mat
+	 */
+	namespace ColumnBlock
+	{
+		constexpr const std::size_t blockCols = 32;
+
+		/**
+		 * update minVal and maxVal with the first num values of row
+		 */
+		inline void minMax(const uint8_t* row, std::size_t num, uint8_t* minVal, uint8_t* maxVal)
+		{
+#if defined(BSCANSEGALGORITHM_AVX2)
+			if(num == blockCols)
+			{
+				const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(minVal), _mm256_min_epu8(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(minVal))));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(maxVal), _mm256_max_epu8(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(maxVal))));
+				return;
+			}
+#elif defined(BSCANSEGALGORITHM_SSE2)
+			if(num == blockCols)
+			{
+				for(std::size_t i = 0; i < blockCols; i += 16)
+				{
+					const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(minVal + i), _mm_min_epu8(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(minVal + i))));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(maxVal + i), _mm_max_epu8(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(maxVal + i))));
+				}
+				return;
+			}
+#endif
+			for(std::size_t i = 0; i < num; ++i)
+			{
+				minVal[i] = std::min(minVal[i], row[i]);
+				maxVal[i] = std::max(maxVal[i], row[i]);
+			}
+		}
+
+		/**
+		 * bit i is set if row[i] >= threshold[i], for the first num values
+		 */
+		inline uint32_t thresholdMask(const uint8_t* row, const uint8_t* threshold, std::size_t num)
+		{
+#if defined(BSCANSEGALGORITHM_AVX2)
+			if(num == blockCols)
+			{
+				const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row));
+				const __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(threshold));
+				return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, t), v)));
+			}
+#elif defined(BSCANSEGALGORITHM_SSE2)
+			if(num == blockCols)
+			{
+				uint32_t mask = 0;
+				for(std::size_t i = 0; i < blockCols; i += 16)
+				{
+					const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+					const __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(threshold + i));
+					mask |= static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, t), v))) << i;
+				}
+				return mask;
+			}
+#endif
+			uint32_t mask = 0;
+			for(std::size_t i = 0; i < num; ++i)
+				if(row[i] >= threshold[i])
+					mask |= 1u << i;
+			return mask;
+		}
+	}
+
 	struct FieldAccVertical
 	{
 		template<typename T>
@@ -43,6 +143,8 @@ namespace
 
 		static std::size_t numInner(const cv::Mat* levelset) { return static_cast<std::size_t>(levelset->rows); }
 		static std::size_t numOuter(const cv::Mat* levelset) { return static_cast<std::size_t>(levelset->cols); }
+
+		static constexpr const bool columnBlocked = true;
 	};
 
 	struct FieldAccHorizontal
@@ -54,6 +156,8 @@ namespace
 
 		static std::size_t numInner(const cv::Mat* levelset) { return static_cast<std::size_t>(levelset->cols); }
 		static std::size_t numOuter(const cv::Mat* levelset) { return static_cast<std::size_t>(levelset->rows); }
+
+		static constexpr const bool columnBlocked = false;
 	};
 
 	struct OpDown : public FieldAccVertical
@@ -160,6 +264,92 @@ namespace
 			}
 		}
 
+		std::size_t matRow(const std::size_t innerPos, const std::size_t numInner) const
+		{
+			return Operator::posDirection?innerPos:numInner-1-innerPos;
+		}
+
+		/**
+		 * column blocked version of iterateRow for the vertical directions
+		 * the image is read row by row for numCols (<= blockCols) adjacent columns,
+		 * the rows where no column reaches the threshold and no column counts strikes are skipped by one vector compare,
+		 * the strike state machine of the remaining columns is the same as in iterateRow
+		 */
+		void iterateColumnBlock(const std::size_t    firstCol
+		                      , const std::size_t    numCols
+		                      , const uint8_t*       grayValues
+		                      , const uint8_t*       breakValues)
+		{
+			assert(numCols > 0 && numCols <= ColumnBlock::blockCols);
+
+			const std::size_t numInner = Operator::numInner(levelSetData);
+
+			int         negStri   [ColumnBlock::blockCols] = {};
+			int         strikes   [ColumnBlock::blockCols] = {};
+			std::size_t changePos [ColumnBlock::blockCols];
+
+			uint32_t running  = numCols == ColumnBlock::blockCols ? ~0u : (1u << numCols) - 1u;
+			uint32_t striking = 0;                                                                 // columns with strikes > 0
+
+			for(std::size_t innerPos = 0; innerPos < numInner && running != 0; ++innerPos)
+			{
+				const uint8_t* imgIt = Operator::template startIt_const<uint8_t>(img, matRow(innerPos, numInner), firstCol);
+				uint32_t       todo  = (ColumnBlock::thresholdMask(imgIt, grayValues, numCols) | striking) & running;
+
+				while(todo != 0)
+				{
+					const int      col    = countTrailingZeros(todo);
+					const uint32_t colBit = 1u << col;
+					todo &= todo - 1u;
+
+					if(imgIt[col] >= grayValues[col])
+					{
+						if(strikes[col] > neededStrikes || imgIt[col] == breakValues[col])
+						{
+							assert(innerPos >= static_cast<std::size_t>(strikes[col]));
+							changePos[col] = innerPos - static_cast<std::size_t>(strikes[col]);
+							running &= ~colBit;
+							continue;
+						}
+						++strikes[col];
+						striking |= colBit;
+					}
+					else
+					{
+						++negStri[col];
+						if(negStri[col] < strikes[col]*negStrikesFactor)
+							++strikes[col];
+						else
+						{
+							strikes[col] = 0;
+							negStri[col] = 0;
+							striking &= ~colBit;
+						}
+					}
+				}
+			}
+
+			for(std::size_t col = 0; col < numCols; ++col)
+				if(running & (1u << col))
+					changePos[col] = numInner - static_cast<std::size_t>(strikes[col]);
+
+			const std::size_t minChangePos = *std::min_element(changePos, changePos + numCols);
+			const std::size_t maxChangePos = *std::max_element(changePos, changePos + numCols);
+
+			for(std::size_t innerPos = 0; innerPos < numInner; ++innerPos)
+			{
+				BScanSegmentationMarker::internalMatType* levelSetIt = Operator::template startIt<BScanSegmentationMarker::internalMatType>(*levelSetData, matRow(innerPos, numInner), firstCol);
+
+				if(innerPos < minChangePos)
+					std::fill_n(levelSetIt, numCols, paintVal0);
+				else if(innerPos >= maxChangePos)
+					std::fill_n(levelSetIt, numCols, paintVal1);
+				else
+					for(std::size_t col = 0; col < numCols; ++col)
+						levelSetIt[col] = innerPos < changePos[col] ? paintVal0 : paintVal1;
+			}
+		}
+
 		void iterateAbsolute(const BScanSegmentationMarker::internalMatType grayValue)
 		{
 			const std::size_t    numInner   = Operator::numInner(levelSetData); // levelSetData->getSizeY();
@@ -167,9 +357,22 @@ namespace
 			const std::size_t    innerStart = Operator::posDirection?0:numInner-1;
 			const std::ptrdiff_t itLineNum  = img.ptr<uint8_t>(1) - img.ptr<uint8_t>(0);
 
-			for(size_t outerPos = 0; outerPos < numOuter; ++outerPos)
+			if constexpr(Operator::columnBlocked)
+			{
+				uint8_t grayValues [ColumnBlock::blockCols];
+				uint8_t breakValues[ColumnBlock::blockCols];
+				std::fill_n(grayValues , ColumnBlock::blockCols, grayValue);
+				std::fill_n(breakValues, ColumnBlock::blockCols, std::numeric_limits<uint8_t>::max());
+
+				for(size_t firstCol = 0; firstCol < numOuter; firstCol += ColumnBlock::blockCols)
+					iterateColumnBlock(firstCol, std::min(ColumnBlock::blockCols, numOuter - firstCol), grayValues, breakValues);
+			}
+			else
 			{
-				iterateRow(grayValue, std::numeric_limits<uint8_t>::max(), innerStart, outerPos, numInner, itLineNum);
+				for(size_t outerPos = 0; outerPos < numOuter; ++outerPos)
+				{
+					iterateRow(grayValue, std::numeric_limits<uint8_t>::max(), innerStart, outerPos, numInner, itLineNum);
+				}
 			}
 		}
 
@@ -180,24 +383,49 @@ namespace
 			const std::size_t    innerStart = Operator::posDirection?0:numInner-1;
 			const std::ptrdiff_t itLineNum  = img.ptr<uint8_t>(1) - img.ptr<uint8_t>(0);
 
-			for(size_t outerPos = 0; outerPos < numOuter; ++outerPos)
+			if constexpr(Operator::columnBlocked)
 			{
-				const uint8_t* imgIt           = Operator::template startIt_const<uint8_t>(img, innerStart, outerPos);
-				uint8_t        maxGrayValueCol = *imgIt;
-				uint8_t        minGrayValueCol = *imgIt;
-
-				for(size_t innerPos = 0; innerPos < numInner; ++innerPos)
+				for(size_t firstCol = 0; firstCol < numOuter; firstCol += ColumnBlock::blockCols)
 				{
-					if(maxGrayValueCol < *imgIt)
-						maxGrayValueCol = *imgIt;
-					else if(minGrayValueCol > *imgIt)
-						minGrayValueCol = *imgIt;
+					const std::size_t numCols = std::min(ColumnBlock::blockCols, numOuter - firstCol);
+
+					uint8_t minGrayValues[ColumnBlock::blockCols];
+					uint8_t maxGrayValues[ColumnBlock::blockCols];
+					uint8_t grayValues   [ColumnBlock::blockCols];
 
-					imgIt = Operator::op(imgIt, itLineNum);
+					const uint8_t* firstRow = Operator::template startIt_const<uint8_t>(img, 0, firstCol);
+					std::copy_n(firstRow, numCols, minGrayValues);
+					std::copy_n(firstRow, numCols, maxGrayValues);
+					for(size_t innerPos = 1; innerPos < numInner; ++innerPos)
+						ColumnBlock::minMax(Operator::template startIt_const<uint8_t>(img, innerPos, firstCol), numCols, minGrayValues, maxGrayValues);
+
+					for(size_t col = 0; col < numCols; ++col)
+						grayValues[col] = static_cast<uint8_t>((maxGrayValues[col]-minGrayValues[col])*frac + minGrayValues[col]);
+
+					iterateColumnBlock(firstCol, numCols, grayValues, maxGrayValues);
 				}
-				const uint8_t grayValue = static_cast<uint8_t>((maxGrayValueCol-minGrayValueCol)*frac + minGrayValueCol);
+			}
+			else
+			{
+				for(size_t outerPos = 0; outerPos < numOuter; ++outerPos)
+				{
+					const uint8_t* imgIt           = Operator::template startIt_const<uint8_t>(img, innerStart, outerPos);
+					uint8_t        maxGrayValueCol = *imgIt;
+					uint8_t        minGrayValueCol = *imgIt;
 
-				iterateRow(grayValue, maxGrayValueCol, innerStart, outerPos, numInner, itLineNum);
+					for(size_t innerPos = 0; innerPos < numInner; ++innerPos)
+					{
+						if(maxGrayValueCol < *imgIt)
+							maxGrayValueCol = *imgIt;
+						else if(minGrayValueCol > *imgIt)
+							minGrayValueCol = *imgIt;
+
+						imgIt = Operator::op(imgIt, itLineNum);
+					}
+					const uint8_t grayValue = static_cast<uint8_t>((maxGrayValueCol-minGrayValueCol)*frac + minGrayValueCol);
+
+					iterateRow(grayValue, maxGrayValueCol, innerStart, outerPos, numInner, itLineNum);
+				}
 			}
 		}
 
@@ -60,6 +60,19 @@ std::shared_ptr<const OctData::BScan> BScanSegLocalOp::getActBScan()
 	return segmentation.getActBScan();
 }
 
+void BScanSegLocalOp::addDirtyRect(int x, int y, int width, int height)
+{
+	segmentation.addActMatDirtyRect(QRect(x, y, width, height));
+}
+
+void BScanSegLocalOp::addDirtyArea(const cv::Mat& area)
+{
+	cv::Size wholeSize;
+	cv::Point offset;
+	area.locateROI(wholeSize, offset);
+	addDirtyRect(offset.x, offset.y, area.cols, area.rows);
+}
+
 BScanSegmentationMarker::internalMatType BScanSegLocalOp::valueOnCoord(int x, int y)
 {
 	return segmentation.valueOnCoord(x, y);
@@ -172,13 +185,18 @@ bool BScanSegLocalOpPaint::drawOnCoord(int x, int y)
 	{
 		case BScanSegmentationMarker::PaintData::PaintMethod::Circle:
 			cv::circle(*map, cv::Point(x, y), paintSize, paintValue, cv::FILLED, 8, 0);
+			addDirtyRect(x-paintSize, y-paintSize, paintSize*2+1, paintSize*2+1);
 			break;
 		case BScanSegmentationMarker::PaintData::PaintMethod::Rect:
 			cv::rectangle(*map, cv::Point(x-paintSize, y-paintSize), cv::Point(x+paintSize-1, y+paintSize-1), paintValue, cv::FILLED, 8, 0);
+			addDirtyRect(x-paintSize, y-paintSize, paintSize*2, paintSize*2);
 			break;
 		case BScanSegmentationMarker::PaintData::PaintMethod::Pen:
 			if(x>0 && y>0 && x<map->cols && y<map->rows)
+			{
 				map->at<BScanSegmentationMarker::internalMatType>(y-1, x-1) = paintValue;
+				addDirtyRect(x-1, y-1, 1, 1);
+			}
 			break;
 	}
 	return true;
@@ -257,6 +275,7 @@ bool BScanSegLocalOpOperation::endOnCoord(int x, int y)
 			medianBlur(cpy, tmp, 3);
 			break;
 	}
+	addDirtyArea(tmp);
 
 	return true;
 }
@@ -335,6 +354,7 @@ bool BScanSegLocalOpThresholdDirection::applyThreshold(int x, int y)
 	cv::Mat tmpImages = bscan->getImage()(cv::Rect(x0, y0, x1-x0, y1-y0));
 
 	BScanSegAlgorithm::initFromThresholdDirection(tmpImages, tmp, localThresholdData, val1, val2);
+	addDirtyArea(tmp);
 
 	return true;
 }
@@ -428,7 +448,10 @@ bool BScanSegLocalOpThreshold::applyThreshold(int x, int y)
 	cv::Mat imageMat;
 	bool result = getLocalImageMat(x, y, imageMat, segMat);
 	if(result)
+	{
 		BScanSegAlgorithm::initFromThreshold(imageMat, segMat, localThresholdData, val1, val2);
+		addDirtyArea(segMat);
+	}
 	return result;
 }
 void BScanSegLocalOpThreshold::setOperatorSizeHeight(int size)
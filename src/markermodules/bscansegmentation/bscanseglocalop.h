@@ -63,6 +63,11 @@ protected:
 	cv::Mat* getActMat();
 	std::shared_ptr<const OctData::BScan> getActBScan();
 
+	/// changes on the act mat must be reported, the undo step stores only the changed area
+	void addDirtyRect(int x, int y, int width, int height);
+	/// area is a sub mat of the act mat
+	void addDirtyArea(const cv::Mat& area);
+
 	std::size_t getBScanNr();
 
 	BScanSegmentationMarker::internalMatType valueOnCoord(int x, int y);
@@ -268,6 +268,7 @@ bool BScanSegLocalOpNN::applyNN(int x, int y)
 
 	segFloat.convertTo(segFloat, cv::DataType<uint8_t>::type, BScanSegmentationMarker::paintArea1Value, 0);
 	segFloat.reshape(0, seg.rows).copyTo(seg);
+	addDirtyArea(seg);
 
 
 	return true;
@@ -18,11 +18,20 @@
 
 #include "bscansegmentation.h"
 
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
 #include <QPainter>
 #include <QMouseEvent>
 #include <QWidget>
 #include<QDialog>
 #include<QTextEdit>
+#include<QProgressDialog>
+#include<QMessageBox>
+#include<QCoreApplication>
 
 #include <manager/octmarkermanager.h>
 
@@ -55,6 +64,7 @@
 BScanSegmentation::BScanSegmentation(OctMarkerManager* markerManager)
 : BscanMarkerBase(markerManager)
 , actMat(new cv::Mat)
+, actMatUndoBase(new cv::Mat)
 {
 	name = tr("Segmentation marker");
 	id   = "SegmentationMarker";
@@ -96,6 +106,7 @@ BScanSegmentation::~BScanSegmentation()
 
 	delete widget;
 	delete actMat;
+	delete actMatUndoBase;
 }
 
 QToolBar* BScanSegmentation::createToolbar(QObject* parent)
@@ -495,6 +506,7 @@ void BScanSegmentation::dilateBScan()
 
 	int iterations = 1;
 	cv::dilate(*actMat, *actMat, cv::Mat(), cv::Point(-1, -1), iterations, cv::BORDER_REFLECT_101, 1);
+	setActMatDirty();
 
 	createUndoStep();
 	updateAreaImage(areaImage.rect());
@@ -509,6 +521,7 @@ void BScanSegmentation::erodeBScan()
 
 	int iterations = 1;
 	cv::erode(*actMat, *actMat, cv::Mat(), cv::Point(-1, -1), iterations, cv::BORDER_REFLECT_101, 1);
+	setActMatDirty();
 
 	createUndoStep();
 	updateAreaImage(areaImage.rect());
@@ -522,6 +535,7 @@ void BScanSegmentation::opencloseBScan()
 		return;
 
 	BScanSegAlgorithm::openClose(*actMat);
+	setActMatDirty();
 
 	createUndoStep();
 	updateAreaImage(areaImage.rect());
@@ -536,6 +550,7 @@ void BScanSegmentation::medianBScan()
 		return;
 
 	medianBlur(*actMat, *actMat, 3);
+	setActMatDirty();
 
 	createUndoStep();
 	updateAreaImage(areaImage.rect());
@@ -549,6 +564,8 @@ void BScanSegmentation::removeUnconectedAreas()
 
 	if(BScanSegAlgorithm::removeUnconectedAreas(*actMat))
 	{
+		setActMatDirty();
+		createUndoStep();
 		updateAreaImage(areaImage.rect());
 		requestFullUpdate();
 	}
@@ -561,6 +578,8 @@ void BScanSegmentation::extendLeftRightSpace()
 
 	if(BScanSegAlgorithm::extendLeftRightSpace(*actMat))
 	{
+		setActMatDirty();
+		createUndoStep();
 		requestFullUpdate();
 		updateAreaImage(areaImage.rect());
 	}
@@ -568,34 +587,18 @@ void BScanSegmentation::extendLeftRightSpace()
 
 void BScanSegmentation::seriesRemoveUnconectedAreas()
 {
-	const std::shared_ptr<const OctData::Series>& series = getSeries();
-	for(std::size_t i=0; i<series->bscanCount(); ++i)
+	applySeriesOperation(tr("Remove unconnected areas"), [](std::size_t, cv::Mat& mat)
 	{
-		if(setActMat(i))
-		{
-			if(actMat)
-				BScanSegAlgorithm::removeUnconectedAreas(*actMat);
-		}
-	}
-	setActMat(getActBScanNr());
-	updateAreaImage(areaImage.rect());
-	requestFullUpdate();
+		return BScanSegAlgorithm::removeUnconectedAreas(mat);
+	});
 }
 
 void BScanSegmentation::seriesExtendLeftRightSpace()
 {
-	const std::shared_ptr<const OctData::Series>& series = getSeries();
-	for(std::size_t i=0; i<series->bscanCount(); ++i)
+	applySeriesOperation(tr("Extend left and right space"), [](std::size_t, cv::Mat& mat)
 	{
-		if(setActMat(i))
-		{
-			if(actMat)
-				BScanSegAlgorithm::extendLeftRightSpace(*actMat);
-		}
-	}
-	setActMat(getActBScanNr());
-	updateAreaImage(areaImage.rect());
-	requestFullUpdate();
+		return BScanSegAlgorithm::extendLeftRightSpace(mat);
+	});
 }
 
 
@@ -603,10 +606,18 @@ void BScanSegmentation::seriesExtendLeftRightSpace()
 
 void BScanSegmentation::clearSegments()
 {
+	if(seriesOperationRunning)
+		seriesOperationInvalidated = true;
+
 	for(auto mat : segments)
 		delete mat;
 
 	segments.clear();
+	segmentsChangeGeneration.clear();
+	savedTree = nullptr;
+
+	actMatDirtyRect    = QRect();
+	actSegmentOutdated = false;
 }
 
 void BScanSegmentation::createSegments()
@@ -637,6 +648,7 @@ void BScanSegmentation::createSegments(const std::shared_ptr<const OctData::Seri
 			mat = new SimpleCvMatCompress;
 		segments.push_back(mat);
 	}
+	segmentsChangeGeneration.resize(segments.size(), 0);
 }
 
 
@@ -655,17 +667,33 @@ void BScanSegmentation::saveState(boost::property_tree::ptree& markerTree)
 	BscanMarkerBase::saveState(markerTree);
 
 	createUndoStep();
+	updateActSegment();
 	BScanSegmentationPtree::fillPTree(markerTree, this);
 	stateChangedSinceLastSave = false;
+
+	savedTree       = &markerTree;
+	savedGeneration = changeGeneration;
 }
 
 void BScanSegmentation::loadState(boost::property_tree::ptree& markerTree)
 {
 	BscanMarkerBase::loadState(markerTree);
 
+	if(seriesOperationRunning)
+		seriesOperationInvalidated = true;
+
+	// without painted segments before, the tree holds afterwards exactly the segments saveState would write
+	bool treeInSync = true;
+	for(const SimpleCvMatCompress* mat : segments)
+		if(mat && !mat->isEmpty(BScanSegmentationMarker::paintArea0Value))
+			treeInSync = false;
+
 	BScanSegmentationPtree::parsePTree(markerTree, this);
 	setActMat(getActBScanNr(), false);
 	stateChangedSinceLastSave = false;
+
+	savedTree       = treeInSync ? &markerTree : nullptr;
+	savedGeneration = changeGeneration;
 }
 
 
@@ -696,6 +724,8 @@ void BScanSegmentation::initBScanFromThreshold(const BScanSegmentationMarker::Th
 
 
 	BScanSegAlgorithm::initFromThresholdDirection(image, *actMat, data, BScanSegmentationMarker::paintArea0Value, BScanSegmentationMarker::paintArea1Value);
+	setActMatDirty();
+	createUndoStep();
 
 	updateAreaImage(areaImage.rect());
 	requestFullUpdate();
@@ -704,23 +734,19 @@ void BScanSegmentation::initBScanFromThreshold(const BScanSegmentationMarker::Th
 
 void BScanSegmentation::initSeriesFromThreshold(const BScanSegmentationMarker::ThresholdDirectionData& data)
 {
-	const std::shared_ptr<const OctData::Series>& series = getSeries();
+	const std::shared_ptr<const OctData::Series> series = getSeries();
+	if(!series)
+		return;
 
-	std::size_t bscanCount = 0;
-	for(const std::shared_ptr<const OctData::BScan>& bscan : series->getBScans())
+	applySeriesOperation(tr("Initialize series from threshold"), [series, data](std::size_t bscanNr, cv::Mat& mat)
 	{
-		const cv::Mat& image = bscan->getImage();
+		const std::shared_ptr<const OctData::BScan> bscan = series->getBScan(bscanNr);
+		if(!bscan || bscan->getImage().empty())
+			return false;
 
-		if(setActMat(bscanCount))
-		{
-			if(actMat && !actMat->empty())
-				BScanSegAlgorithm::initFromThresholdDirection(image, *actMat, data, BScanSegmentationMarker::paintArea0Value, BScanSegmentationMarker::paintArea1Value);
-		}
-		++bscanCount;
-	}
-	setActMat(getActBScanNr());
-	updateAreaImage(areaImage.rect());
-	requestFullUpdate();
+		BScanSegAlgorithm::initFromThresholdDirection(bscan->getImage(), mat, data, BScanSegmentationMarker::paintArea0Value, BScanSegmentationMarker::paintArea1Value);
+		return true;
+	});
 }
 
 void BScanSegmentation::initBScanFromSegline(OctData::Segmentationlines::SegmentlineType type)
@@ -738,6 +764,8 @@ void BScanSegmentation::initBScanFromSegline(OctData::Segmentationlines::Segment
 		return;
 
 	BScanSegAlgorithm::initFromSegline(*bscan, *actMat, type);
+	setActMatDirty();
+	createUndoStep();
 
 	updateAreaImage(areaImage.rect());
 	requestFullUpdate();
@@ -745,26 +773,164 @@ void BScanSegmentation::initBScanFromSegline(OctData::Segmentationlines::Segment
 
 void BScanSegmentation::initSeriesFromSegline(OctData::Segmentationlines::SegmentlineType type)
 {
-	const std::shared_ptr<const OctData::Series>& series = getSeries();
-
+	const std::shared_ptr<const OctData::Series> series = getSeries();
+	if(!series)
+		return;
 
-	std::size_t bscanCount = 0;
-	for(const std::shared_ptr<const OctData::BScan>& bscan : series->getBScans())
+	applySeriesOperation(tr("Initialize series from segmentation line"), [series, type](std::size_t bscanNr, cv::Mat& mat)
 	{
+		const std::shared_ptr<const OctData::BScan> bscan = series->getBScan(bscanNr);
 		if(!bscan)
-			continue;
+			return false;
+
+		BScanSegAlgorithm::initFromSegline(*bscan, mat, type);
+		return true;
+	});
+}
+
 
-		if(setActMat(bscanCount))
+void BScanSegmentation::applySeriesOperation(const QString& title, const SeriesOperation& op)
+{
+	const std::shared_ptr<const OctData::Series> series = getSeries(); // own reference for the workers
+	if(!series || segments.empty() || seriesOperationRunning)
+		return;
+
+	createUndoStep();
+	updateActSegment();
+
+	// the workers use only copies, the module can change while the events are processed
+	// every bscan is handled by exactly one worker, so the workers write to distinct elements
+	const std::size_t numBScans = segments.size();
+	std::vector<SimpleCvMatCompress> workSegments(numBScans);
+	std::vector<char>                changed     (numBScans, 0);
+	for(std::size_t bscanNr = 0; bscanNr < numBScans; ++bscanNr)
+		workSegments[bscanNr] = *segments[bscanNr];
+
+	std::atomic<std::size_t> nextBScan(0);
+	std::atomic<std::size_t> finishedBScans(0);
+	std::atomic<bool>        aborted(false);
+	std::mutex               errorMutex;
+	std::string              errorMessage;
+
+	auto worker = [&workSegments, &changed, &nextBScan, &finishedBScans, &aborted, &errorMutex, &errorMessage, &op, series, numBScans]()
+	{
+		cv::Mat mat;
+		SimpleCvMatCompress newSegment;
+		for(std::size_t bscanNr = nextBScan++; bscanNr < numBScans && !aborted; bscanNr = nextBScan++)
 		{
-			if(actMat && !actMat->empty())
-				BScanSegAlgorithm::initFromSegline(*bscan, *actMat, type);
+			try
+			{
+				SimpleCvMatCompress& segment = workSegments[bscanNr];
+				segment.writeToMat(mat);
+				if(mat.empty())
+				{
+					const std::shared_ptr<const OctData::BScan> bscan = series->getBScan(bscanNr);
+					if(bscan)
+						mat = cv::Mat(bscan->getHeight(), bscan->getWidth(), cv::DataType<uint8_t>::type, cv::Scalar(BScanSegmentationMarker::markermatInitialValue));
+				}
 
+				if(!mat.empty() && op(bscanNr, mat))
+				{
+					newSegment.readFromMat(mat);
+					if(newSegment != segment)
+					{
+						segment          = std::move(newSegment);
+						changed[bscanNr] = 1;
+					}
+				}
+			}
+			catch(const std::exception& e)
+			{
+				std::lock_guard<std::mutex> lock(errorMutex);
+				errorMessage = e.what();
+				aborted      = true;
+			}
+			++finishedBScans;
 		}
-		++bscanCount;
+	};
+
+	seriesOperationRunning     = true;
+	seriesOperationInvalidated = false;
+
+	const std::size_t numThreads = std::min(numBScans, static_cast<std::size_t>(std::max(1u, std::thread::hardware_concurrency())));
+	std::vector<std::thread> threads;
+	for(std::size_t i = 0; i < numThreads; ++i)
+		threads.emplace_back(worker);
+
+	QProgressDialog progress(title, tr("Cancel"), 0, static_cast<int>(numBScans), widgetPtr2WGSegmentation);
+	progress.setWindowModality(Qt::ApplicationModal);
+	progress.setMinimumDuration(500);
+	while(finishedBScans < numBScans && !aborted && !seriesOperationInvalidated)
+	{
+		progress.setValue(static_cast<int>(finishedBScans));
+		// user input is blocked by the modal dialog, before it is shown the input is not processed
+		QCoreApplication::processEvents(progress.isVisible() ? QEventLoop::AllEvents : QEventLoop::ExcludeUserInputEvents, 20);
+		if(progress.wasCanceled())
+			aborted = true;
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
 	}
-	setActMat(getActBScanNr());
-	updateAreaImage(areaImage.rect());
+
+	if(seriesOperationInvalidated)
+		aborted = true;
+
+	for(std::thread& t : threads)
+		t.join();
+	progress.setValue(static_cast<int>(numBScans));
+
+	const bool invalidated = seriesOperationInvalidated;
+	seriesOperationRunning     = false;
+	seriesOperationInvalidated = false;
+
+	if(invalidated) // the segments belong to another series or state now, the result is dropped
+		return;
+
+	// the operation is applied to the whole series or not at all
+	FreeFormSegSeriesCommand::Segments changedSegments;
+	if(!aborted)
+	{
+		for(std::size_t bscanNr = 0; bscanNr < numBScans; ++bscanNr)
+		{
+			if(!changed[bscanNr])
+				continue;
+
+			changedSegments.emplace_back(bscanNr, std::move(*segments[bscanNr]));
+			*segments[bscanNr] = std::move(workSegments[bscanNr]);
+			setBScanChanged(bscanNr);
+		}
+	}
+
+	if(!errorMessage.empty())
+		QMessageBox::critical(widgetPtr2WGSegmentation, title, QString::fromStdString(errorMessage));
+
+	if(!changedSegments.empty())
+	{
+		addUndoCommand(new FreeFormSegSeriesCommand(*this, std::move(changedSegments)));
+		stateChangedSinceLastSave = true;
+	}
+
+	setActMat(getActBScanNr(), false);
+	requestFullUpdate();
+}
+
+
+bool BScanSegmentation::swapSegments(FreeFormSegSeriesCommand::Segments& changedSegments)
+{
+	for(const std::pair<std::size_t, SimpleCvMatCompress>& segment : changedSegments)
+		if(segment.first >= segments.size())
+			return false;
+
+	updateActSegment();
+	for(std::pair<std::size_t, SimpleCvMatCompress>& segment : changedSegments)
+	{
+		std::swap(*segments[segment.first], segment.second);
+		setBScanChanged(segment.first);
+	}
+	stateChangedSinceLastSave = true;
+
+	setActMat(getActBScanNr(), false);
 	requestFullUpdate();
+	return true;
 }
 
 
@@ -807,7 +973,10 @@ bool BScanSegmentation::setActMat(std::size_t nr, bool saveOldState)
 	if(actMat)
 	{
 		if(saveOldState)
+		{
 			createUndoStep(); // save state from old bscan
+			updateActSegment();
+		}
 
 		if(segments.size() > nr)
 		{
@@ -822,6 +991,9 @@ bool BScanSegmentation::setActMat(std::size_t nr, bool saveOldState)
 					*actMat = cv::Mat(bscan->getHeight(), bscan->getWidth(), cv::DataType<uint8_t>::type, cv::Scalar(BScanSegmentationMarker::markermatInitialValue));
 				}
 			}
+			actMat->copyTo(*actMatUndoBase);
+			actMatDirtyRect    = QRect();
+			actSegmentOutdated = false;
 			areaImage = QImage(QSize(actMat->cols, actMat->rows), QImage::Format_ARGB32_Premultiplied);
 			updateAreaImage(areaImage.rect());
 			return true;
@@ -878,50 +1050,120 @@ void BScanSegmentation::updateAreaImage(const QRect& rect)
 	}
 }
 
-void BScanSegmentation::createUndoStep()
+void BScanSegmentation::setActMatDirty()
 {
-	if(actMat && segments.size() > actMatNr)
-	{
-		SimpleCvMatCompress newMat;
-		newMat.readFromMat(*actMat);
+	if(actMat)
+		actMatDirtyRect = QRect(0, 0, actMat->cols, actMat->rows);
+}
 
-		if((*segments[actMatNr]) != newMat)
-		{
-			stateChangedSinceLastSave = true;
+void BScanSegmentation::updateActSegment()
+{
+	if(actSegmentOutdated && actMat && segments.size() > actMatNr)
+		segments[actMatNr]->readFromMat(*actMat);
+	actSegmentOutdated = false;
+}
 
-			FreeFormSegCommand* command = new FreeFormSegCommand(*this, *(segments[actMatNr]));
-			addUndoCommand(command);
+namespace
+{
+	bool isAreaEqual(const cv::Mat& m1, const cv::Mat& m2)
+	{
+		const std::size_t rowBytes = static_cast<std::size_t>(m1.cols)*m1.elemSize();
+		for(int row = 0; row < m1.rows; ++row)
+			if(std::memcmp(m1.ptr(row), m2.ptr(row), rowBytes) != 0)
+				return false;
+		return true;
+	}
 
-			*(segments[actMatNr]) = newMat;
-		}
+	cv::Rect toCvRect(const QRect& rect)
+	{
+		return cv::Rect(rect.x(), rect.y(), rect.width(), rect.height());
 	}
 }
 
+void BScanSegmentation::createUndoStep()
+{
+	if(!actMat || actMatDirtyRect.isEmpty() || segments.size() <= actMatNr)
+		return;
+
+	const QRect dirtyRect = actMatDirtyRect & QRect(0, 0, actMat->cols, actMat->rows);
+	actMatDirtyRect = QRect();
+
+	if(dirtyRect.isEmpty() || actMatUndoBase->size() != actMat->size())
+		return;
+
+	const cv::Mat newArea = (*actMat        )(toCvRect(dirtyRect));
+	      cv::Mat oldArea = (*actMatUndoBase)(toCvRect(dirtyRect));
+	if(isAreaEqual(newArea, oldArea))
+		return;
+
+	SimpleCvMatCompress patch;
+	patch.readFromMat(oldArea);
+	// actMatUndoBase holds the state before this step while the command is added (needed by mergeActMatPatch)
+	addUndoCommand(new FreeFormSegCommand(*this, actMatNr, dirtyRect, std::move(patch)));
+
+	newArea.copyTo(oldArea);
+
+	stateChangedSinceLastSave = true;
+	actSegmentOutdated        = true;
+	setBScanChanged(actMatNr);
+}
+
 
-bool BScanSegmentation::swapActMat(SimpleCvMatCompress& otherMat)
+bool BScanSegmentation::swapActMatPatch(std::size_t bscanNr, const QRect& rect, SimpleCvMatCompress& patch)
 {
-	if(!actMat)
+	if(!actMat || bscanNr != actMatNr || segments.size() <= actMatNr)
 		return false;
 
-	SimpleCvMatCompress oldMat;
-	oldMat.readFromMat(*actMat);
-	otherMat.writeToMat(*actMat);
+	if(!QRect(0, 0, actMat->cols, actMat->rows).contains(rect) || patch.getRows() != rect.height() || patch.getCols() != rect.width())
+		return false;
 
-	*(segments[actMatNr]) = otherMat;
+	cv::Mat area = (*actMat)(toCvRect(rect));
+	SimpleCvMatCompress oldPatch;
+	oldPatch.readFromMat(area);
+	patch.writeToMat(area);
+	area.copyTo((*actMatUndoBase)(toCvRect(rect)));
 
-	std::swap(oldMat, otherMat);
+	std::swap(oldPatch, patch);
 
-	updateAreaImage(areaImage.rect());
+	stateChangedSinceLastSave = true;
+	actSegmentOutdated        = true;
+	setBScanChanged(actMatNr);
+
+	updateAreaImage(rect);
 	requestFullUpdate();
 	return true;
 }
 
 
+bool BScanSegmentation::mergeActMatPatch(std::size_t bscanNr, QRect& rect, SimpleCvMatCompress& patch, const QRect& nextRect) const
+{
+	if(!actMat || bscanNr != actMatNr || actMatUndoBase->size() != actMat->size())
+		return false;
+
+	const QRect mergedRect = (rect | nextRect) & QRect(0, 0, actMatUndoBase->cols, actMatUndoBase->rows);
+	if(!mergedRect.contains(rect) || patch.getRows() != rect.height() || patch.getCols() != rect.width())
+		return false;
+
+	// state before the next step, the area of the first step is reset with its patch
+	cv::Mat mergedArea = (*actMatUndoBase)(toCvRect(mergedRect)).clone();
+	cv::Mat patchArea  = mergedArea(toCvRect(rect.translated(-mergedRect.topLeft())));
+	patch.writeToMat(patchArea);
+
+	patch.readFromMat(mergedArea);
+	rect = mergedRect;
+	return true;
+}
+
+
 bool BScanSegmentation::hasActMatChanged() const
 {
-	if(actMat && segments.size() > actMatNr)
-		return (*segments[actMatNr]) != *actMat;
-	return false;
+	if(!actMat || actMatDirtyRect.isEmpty() || actMatUndoBase->size() != actMat->size())
+		return false;
+
+	const QRect dirtyRect = actMatDirtyRect & QRect(0, 0, actMat->cols, actMat->rows);
+	if(dirtyRect.isEmpty())
+		return false;
+	return !isAreaEqual((*actMat)(toCvRect(dirtyRect)), (*actMatUndoBase)(toCvRect(dirtyRect)));
 }
 
 
@@ -30,8 +30,10 @@
 
 #include "../bscanmarkerbase.h"
 #include "configdata.h"
+#include "freeformsegcommand.h"
 
 #include <vector>
+#include <functional>
 #include <boost/icl/interval_map.hpp>
 
 #include <QPoint>
@@ -97,13 +99,30 @@ class BScanSegmentation : public BscanMarkerBase
 	QWidget* widgetPtr2WGSegmentation = nullptr;
 	
 	SegMats segments;
+	std::vector<std::size_t> segmentsChangeGeneration; ///< value of changeGeneration at the last change of the segment
 	mutable cv::Mat* actMat = nullptr;
 	mutable std::size_t actMatNr = 0;
 	QImage areaImage;
 
+	// undo steps store only the changed rect of actMat, segments[actMatNr] is rebuilt on bscan change and save
+	cv::Mat* actMatUndoBase = nullptr;                             ///< actMat at the last undo step
+	QRect actMatDirtyRect;                                         ///< area of actMat changed since the last undo step
+	bool actSegmentOutdated = false;                               ///< segments[actMatNr] misses undo steps of actMat
+
+	void addActMatDirtyRect(const QRect& rect)                      { actMatDirtyRect |= rect; }
+	void setActMatDirty();
+	void updateActSegment();
+
 	void updateAreaImage(const QRect& rect);
 	void updateAreaImage(const RedrawRequest& redraw, const ScaleFactor& factor);
 
+	// saveState writes only the bscans changed since the last write to the same ptree
+	std::size_t changeGeneration = 0;
+	std::size_t savedGeneration  = 0;
+	const boost::property_tree::ptree* savedTree = nullptr;
+
+	void setBScanChanged(std::size_t bscanNr)                       { segmentsChangeGeneration[bscanNr] = ++changeGeneration; }
+
 	void clearSegments();
 	void createSegments();
 	void createSegments(const std::shared_ptr<const OctData::Series>& series);
@@ -127,6 +146,15 @@ class BScanSegmentation : public BscanMarkerBase
 	bool setActMat(std::size_t nr, bool saveOldState = true);
 	bool hasActMatChanged() const;
 
+	/// operation on the segmentation mat of one bscan, returns true if the mat was modified
+	typedef std::function<bool(std::size_t bscanNr, cv::Mat& mat)> SeriesOperation;
+	/// applies op in parallel to all bscans and records one undo step for the whole series
+	void applySeriesOperation(const QString& title, const SeriesOperation& op);
+
+	// applySeriesOperation processes events while its workers run, a new series or state cancels the operation
+	bool seriesOperationRunning     = false;
+	bool seriesOperationInvalidated = false;                       ///< segments were recreated while the operation was running
+
 	QString generateTikzCode() const;
 
 public:
@@ -148,6 +176,8 @@ public:
 
 	void saveState(boost::property_tree::ptree& markerTree)  override;
 	void loadState(boost::property_tree::ptree& markerTree)  override;
+	bool isStateSavedIn(const boost::property_tree::ptree& markerTree) const override
+	                                                                { return savedTree == &markerTree && savedGeneration == changeGeneration && !hasActMatChanged(); }
 
 	void setActBScan(std::size_t bscan)  override                   { setActMat(bscan, true); }
 	bool hasChangedSinceLastSave() const override                   { if(stateChangedSinceLastSave) return true; return hasActMatChanged(); }
@@ -161,7 +191,9 @@ public:
 
 
 	BScanSegmentationMarker::LocalMethod getLocalMethod() const     { return localMethod; }
-	bool swapActMat(SimpleCvMatCompress& otherMat);
+	bool swapActMatPatch(std::size_t bscanNr, const QRect& rect, SimpleCvMatCompress& patch);
+	bool mergeActMatPatch(std::size_t bscanNr, QRect& rect, SimpleCvMatCompress& patch, const QRect& nextRect) const;
+	bool swapSegments(FreeFormSegSeriesCommand::Segments& changedSegments);
 
 	void createUndoStep();
 
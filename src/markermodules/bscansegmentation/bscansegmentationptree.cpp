@@ -28,14 +28,6 @@
 #include <boost/lexical_cast.hpp>
 namespace bpt = boost::property_tree;
 
-#include <sstream>
-
-#include <boost/archive/text_oarchive.hpp>
-#include <boost/archive/text_iarchive.hpp>
-
-#include <boost/serialization/vector.hpp>
-#include <boost/serialization/string.hpp>
-
 
 #include "bscansegmentation.h"
 
@@ -52,7 +44,7 @@ bool BScanSegmentationPtree::parsePTree(const boost::property_tree::ptree& ptree
 		return false;
 
 
-	for(const std::pair<const std::string, const bpt::ptree>& bscanPair : *bscansNode)
+	for(const std::pair<const std::string, bpt::ptree>& bscanPair : *bscansNode)
 	{
 		if(bscanPair.first != "BScan")
 			continue;
@@ -71,14 +63,7 @@ bool BScanSegmentationPtree::parsePTree(const boost::property_tree::ptree& ptree
 			boost::optional<const bpt::ptree&> matCompressNode = bscanNode.get_child_optional("matCompress");
 			if(matCompressNode)
 			{
-				std::string serializationString = matCompressNode->get_value<std::string>("");
-
-				if(serializationString.size() < 2)
-					continue;
-
-				std::stringstream ioa(serializationString);
-				boost::archive::text_iarchive oa(ioa);
-				oa >> *compressedMat;
+				compressedMat->fromString(matCompressNode->data());
 
 // 				compressedMat.writeMat(*map);
 			}
@@ -96,29 +81,52 @@ bool BScanSegmentationPtree::parsePTree(const boost::property_tree::ptree& ptree
 
 void BScanSegmentationPtree::fillPTree(boost::property_tree::ptree& markerTree, const BScanSegmentation* markerManager)
 {
-	markerTree.erase("ILM");
-	bpt::ptree& ilmTree = markerTree.put("ILM", std::string());
+	const std::size_t numBscans = markerManager->getNumBScans();
 
-	std::size_t numBscans = markerManager->getNumBScans();
-	for(std::size_t bscan = 0; bscan < numBscans; ++bscan)
+	// the tree holds the state of savedGeneration, only later changed bscans are rewritten
+	boost::optional<bpt::ptree&> existingIlmTree = markerTree.get_child_optional("ILM");
+	const bool updateTree = markerManager->savedTree == &markerTree && existingIlmTree;
+
+	if(!updateTree)
 	{
-		// const cv::Mat* map = markerManager->segments.at(bscan);
-		const SimpleCvMatCompress* compressedMat = markerManager->segments.at(bscan);
-		if(compressedMat)
+		markerTree.erase("ILM");
+		existingIlmTree = markerTree.put("ILM", std::string());
+	}
+	bpt::ptree& ilmTree = *existingIlmTree;
+
+	std::vector<bpt::ptree::iterator> bscanNodes(numBscans, ilmTree.end());
+	if(updateTree)
+	{
+		for(bpt::ptree::iterator it = ilmTree.begin(); it != ilmTree.end(); ++it)
 		{
-			if(compressedMat->isEmpty(BScanSegmentationMarker::paintArea0Value))
+			if(it->first != "BScan")
 				continue;
+			const int bscanId = it->second.get<int>("ID", -1);
+			if(bscanId >= 0 && static_cast<std::size_t>(bscanId) < numBscans && bscanNodes[bscanId] == ilmTree.end())
+				bscanNodes[bscanId] = it;
+		}
+	}
 
-			std::stringstream ofs;
-			boost::archive::text_oarchive oa(ofs);
-			// write class instance to archive
-			oa << *compressedMat;
+	for(std::size_t bscan = 0; bscan < numBscans; ++bscan)
+	{
+		if(updateTree && markerManager->segmentsChangeGeneration[bscan] <= markerManager->savedGeneration)
+			continue;
 
-			std::string nodeName = "BScan";
-			bpt::ptree& bscanNode = ilmTree.add(nodeName, "");
+		const SimpleCvMatCompress* compressedMat = markerManager->segments.at(bscan);
+		if(!compressedMat || compressedMat->isEmpty(BScanSegmentationMarker::paintArea0Value))
+		{
+			if(bscanNodes[bscan] != ilmTree.end())
+				ilmTree.erase(bscanNodes[bscan]);
+			continue;
+		}
+
+		if(bscanNodes[bscan] != ilmTree.end())
+			bscanNodes[bscan]->second.put("matCompress", compressedMat->toString());
+		else
+		{
+			bpt::ptree& bscanNode = ilmTree.add("BScan", "");
 			bscanNode.add("ID", boost::lexical_cast<std::string>(bscan));
-			bscanNode.put("matCompress", ofs.str());
+			bscanNode.put("matCompress", compressedMat->toString());
 		}
 	}
 }
-
@@ -19,14 +19,13 @@
 
 #include "freeformsegcommand.h"
 
-#include<data_structure/simplecvmatcompress.h>
-
 #include"bscansegmentation.h"
 
-FreeFormSegCommand::FreeFormSegCommand(BScanSegmentation& parent, const SimpleCvMatCompress& mat)
+FreeFormSegCommand::FreeFormSegCommand(BScanSegmentation& parent, std::size_t bscanNr, const QRect& rect, SimpleCvMatCompress&& patch)
 : parent(parent)
-, segmentationMat(new SimpleCvMatCompress(mat))
-, bscanNr(parent.getActBScanNr())
+, patch(std::move(patch))
+, patchRect(rect)
+, bscanNr(bscanNr)
 {
 	MarkerCommand::bscan = static_cast<int>(bscanNr);
 }
@@ -34,7 +33,6 @@ FreeFormSegCommand::FreeFormSegCommand(BScanSegmentation& parent, const SimpleCv
 
 FreeFormSegCommand::~FreeFormSegCommand()
 {
-	delete segmentationMat;
 }
 
 
@@ -45,10 +43,59 @@ void FreeFormSegCommand::apply()
 
 bool FreeFormSegCommand::undo()
 {
-	return parent.swapActMat(*segmentationMat);
+	return parent.swapActMatPatch(bscanNr, patchRect, patch);
 }
 
 bool FreeFormSegCommand::redo()
 {
-	return parent.swapActMat(*segmentationMat);
+	return parent.swapActMatPatch(bscanNr, patchRect, patch);
+}
+
+std::size_t FreeFormSegCommand::getMemoryUsage() const
+{
+	return sizeof(*this) + patch.getMemoryUsage();
+}
+
+bool FreeFormSegCommand::mergeWith(const MarkerCommand& next)
+{
+	const FreeFormSegCommand* nextCommand = dynamic_cast<const FreeFormSegCommand*>(&next);
+	if(!nextCommand || nextCommand->bscanNr != bscanNr)
+		return false;
+
+	// only touching patches are merged, the merged patch covers the bounding rect of both
+	if(!patchRect.adjusted(-1, -1, 1, 1).intersects(nextCommand->patchRect))
+		return false;
+
+	return parent.mergeActMatPatch(bscanNr, patchRect, patch, nextCommand->patchRect);
+}
+
+
+
+FreeFormSegSeriesCommand::FreeFormSegSeriesCommand(BScanSegmentation& parent, Segments&& segments)
+: parent(parent)
+, segments(std::move(segments))
+{
+}
+
+void FreeFormSegSeriesCommand::apply()
+{
+
+}
+
+bool FreeFormSegSeriesCommand::undo()
+{
+	return parent.swapSegments(segments);
+}
+
+bool FreeFormSegSeriesCommand::redo()
+{
+	return parent.swapSegments(segments);
+}
+
+std::size_t FreeFormSegSeriesCommand::getMemoryUsage() const
+{
+	std::size_t memory = sizeof(*this) + segments.capacity()*sizeof(Segments::value_type);
+	for(const Segments::value_type& segment : segments)
+		memory += segment.second.getMemoryUsage();
+	return memory;
 }
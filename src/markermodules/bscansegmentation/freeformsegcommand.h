@@ -20,26 +20,32 @@
 #define FREEFORMSEGCOMMAND_H
 
 #include<cstddef>
+#include<vector>
+#include<utility>
+
+#include<QRect>
 
 #include<markermodules/markercommand.h>
+#include<data_structure/simplecvmatcompress.h>
 
 class BScanSegmentation;
-class SimpleCvMatCompress;
 
 /**
  *  @ingroup FreeFormSegmentation
  *  @brief Class for supporting undo and redo function of the free form segmentation
  *
+ *  Holds only the changed rect of the bscan, undo and redo swap it with the act mat.
  */
 class FreeFormSegCommand : public MarkerCommand
 {
 	BScanSegmentation& parent;
-	SimpleCvMatCompress* segmentationMat;
+	SimpleCvMatCompress patch;
+	QRect               patchRect;
 
 	std::size_t bscanNr;
 
 public:
-	FreeFormSegCommand(BScanSegmentation& parent, const SimpleCvMatCompress& mat);
+	FreeFormSegCommand(BScanSegmentation& parent, std::size_t bscanNr, const QRect& rect, SimpleCvMatCompress&& patch);
 	~FreeFormSegCommand() override;
 
 	FreeFormSegCommand(const FreeFormSegCommand &other)            = delete;
@@ -49,6 +55,37 @@ public:
 	void apply() override;
 	bool undo() override;
 	bool redo() override;
+
+	std::size_t getMemoryUsage() const override;
+	bool mergeWith(const MarkerCommand& next) override;
+};
+
+
+/**
+ *  @ingroup FreeFormSegmentation
+ *  @brief Undo and redo of a free form segmentation operation on the whole series
+ *
+ *  Holds the segmentation of the changed bscans, undo and redo swap them with the segments of the series.
+ */
+class FreeFormSegSeriesCommand : public MarkerCommand
+{
+public:
+	typedef std::vector<std::pair<std::size_t, SimpleCvMatCompress>> Segments;
+
+	FreeFormSegSeriesCommand(BScanSegmentation& parent, Segments&& segments);
+
+	FreeFormSegSeriesCommand(const FreeFormSegSeriesCommand &other)            = delete;
+	FreeFormSegSeriesCommand &operator=(const FreeFormSegSeriesCommand &other) = delete;
+
+	void apply() override;
+	bool undo() override;
+	bool redo() override;
+
+	std::size_t getMemoryUsage() const override;
+
+private:
+	BScanSegmentation& parent;
+	Segments segments;
 };
 
 #endif // FREEFORMSEGCOMMAND_H
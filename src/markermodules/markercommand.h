@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include<cstddef>
 
 
 /** \ingroup MarkerModule
@@ -34,6 +35,11 @@ public:
 	virtual void apply() = 0;
 	int getBScan() const { return bscan; }
 
+	/// approximate memory of the command in bytes, for the undo memory budget of the module
+	virtual std::size_t getMemoryUsage() const = 0;
+	/// merges next, executed directly after this command on the same bscan, into this command
+	virtual bool mergeWith(const MarkerCommand& /*next*/)            { return false; }
+
 protected:
 	int bscan = -1;
 };
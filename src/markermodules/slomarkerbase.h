@@ -61,6 +61,9 @@ public:
 
 	virtual void saveState(boost::property_tree::ptree&)            {}
 	virtual void loadState(boost::property_tree::ptree&)            {}
+	/// true if the last saveState or loadState used this tree and the state has not changed since, saveState can be skipped
+	virtual bool isStateSavedIn(const boost::property_tree::ptree&) const
+	                                                                { return false; }
 
 	virtual void newSeriesLoaded(const std::shared_ptr<const OctData::Series>&, boost::property_tree::ptree&)
 	                                                                {}
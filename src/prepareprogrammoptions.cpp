@@ -37,6 +37,8 @@ void PrepareProgrammOptions::prepareProgrammOptions()
 	QAction* autoSaveOctMarkers = ProgramOptions::autoSaveOctMarkers.getAction();
 	autoSaveOctMarkers->setText(tr("Autosave markers"));
 
+	ProgramOptions::undoMemoryBudgetMiB.setDescriptions(tr("Undo memory per marker (MiB)"), tr("Memory limit for the undo history of each marker module, the oldest steps are removed first"));
+
 
 	QAction* fillEpmtyPixelWhite = ProgramOptions::fillEmptyPixelWhite.getAction();
 	QAction* registerBScans      = ProgramOptions::registerBScans     .getAction();
@@ -75,6 +77,8 @@ void PrepareProgrammOptions::prepareProgrammOptions()
 	sloClipScanArea->setText(tr("clip to scan area"));
 	sloClipScanArea->setIcon(QIcon::fromTheme("view-fullscreen", QIcon(":/icons/tango/actions/system-search.svgz")));
 
+	ProgramOptions::sloDistanceMapCache.setDescriptions(tr("cache SLO distance maps"), tr("Store the SLO distance maps in the cache directory and reuse them for series with the same geometry"));
+
 	/*
 	 *  Intervall mark spezific options
 	 */
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "bscanframecache.h"
+
+#include<algorithm>
+
+#include<octdata/datastruct/series.h>
+#include<octdata/datastruct/bscan.h>
+
+
+BScanFrameCache::BScanFrameCache(std::size_t capacity, std::size_t prefetchAhead)
+: capacity(std::max(capacity, prefetchAhead + 2))
+, prefetchAhead(prefetchAhead)
+{
+	worker = std::thread(&BScanFrameCache::run, this);
+}
+
+BScanFrameCache::~BScanFrameCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+		jobs.clear();
+	}
+	jobCondition.notify_all();
+	worker.join();
+}
+
+
+BScanFrameCache::FramePtr BScanFrameCache::getFrame(const std::shared_ptr<const OctData::BScan>& bscan)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::list<Entry>::iterator it = std::find_if(frames.begin(), frames.end(), [&bscan](const Entry& e) { return e.bscan == bscan; });
+	if(it == frames.end())
+		return nullptr;
+
+	frames.splice(frames.begin(), frames, it);
+	return it->frame;
+}
+
+void BScanFrameCache::addFrame(const std::shared_ptr<const OctData::BScan>& bscan, FramePtr frame)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	insertFrame(bscan, std::move(frame));
+}
+
+
+void BScanFrameCache::prefetch(const std::shared_ptr<const OctData::Series>& series, std::size_t bscanNr, int direction, const CVImageWidget::ImagePreparer& imagePreparer)
+{
+	if(!series)
+		return;
+
+	const std::size_t bscanCount = series->bscanCount();
+	const int step = direction < 0 ? -1 : 1;
+
+	std::vector<std::shared_ptr<const OctData::BScan>> newJobs;
+	auto addJob = [&](std::size_t nr)
+	{
+		const std::shared_ptr<const OctData::BScan> bscan = series->getBScan(nr);
+		if(bscan)
+			newJobs.push_back(bscan);
+	};
+
+	for(std::size_t i = 1; i <= prefetchAhead; ++i)
+	{
+		const long long nr = static_cast<long long>(bscanNr) + step*static_cast<long long>(i);
+		if(nr < 0 || nr >= static_cast<long long>(bscanCount))
+			break;
+		addJob(static_cast<std::size_t>(nr));
+	}
+	const long long behindNr = static_cast<long long>(bscanNr) - step;
+	if(behindNr >= 0 && behindNr < static_cast<long long>(bscanCount))
+		addJob(static_cast<std::size_t>(behindNr));
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		preparer = imagePreparer;
+		jobs.clear();
+		for(std::shared_ptr<const OctData::BScan>& bscan : newJobs)
+			if(!containsFrame(bscan.get()))
+				jobs.push_back(std::move(bscan));
+	}
+	jobCondition.notify_one();
+}
+
+
+void BScanFrameCache::invalidate()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	++generation;
+	jobs.clear();
+	frames.clear();
+	idleCondition.wait(lock, [this] { return !working; });
+}
+
+
+void BScanFrameCache::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for(;;)
+	{
+		jobCondition.wait(lock, [this] { return stop || !jobs.empty(); });
+		if(stop)
+			return;
+
+		const std::shared_ptr<const OctData::BScan> bscan = std::move(jobs.front());
+		jobs.pop_front();
+		if(containsFrame(bscan.get()) || !preparer)
+			continue;
+
+		const std::size_t                  jobGeneration = generation;
+		const CVImageWidget::ImagePreparer jobPreparer   = preparer;
+		working = true;
+		lock.unlock();
+
+		std::shared_ptr<CVImageWidget::PreparedImage> frame = std::make_shared<CVImageWidget::PreparedImage>();
+		const bool prepared = jobPreparer(bscan->getImage(), *frame);
+
+		lock.lock();
+		working = false;
+		if(prepared && jobGeneration == generation)
+			insertFrame(bscan, std::move(frame));
+		idleCondition.notify_all();
+	}
+}
+
+
+bool BScanFrameCache::containsFrame(const OctData::BScan* bscan) const
+{
+	return std::any_of(frames.begin(), frames.end(), [bscan](const Entry& e) { return e.bscan.get() == bscan; });
+}
+
+void BScanFrameCache::insertFrame(const std::shared_ptr<const OctData::BScan>& bscan, FramePtr frame)
+{
+	if(containsFrame(bscan.get()))
+		return;
+
+	frames.push_front(Entry{bscan, std::move(frame)});
+	while(frames.size() > capacity)
+		frames.pop_back();
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BSCANFRAMECACHE_H
+#define BSCANFRAMECACHE_H
+
+#include<memory>
+#include<list>
+#include<deque>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+
+#include "cvimagewidget.h"
+
+namespace OctData { class Series; class BScan; }
+
+/**
+ * @ingroup Widget
+ * @brief LRU cache of prepared (converted and filtered) B-scan images
+ *
+ * A worker thread prepares the B-scans in scroll direction ahead of time.
+ * invalidate has to be called when the image preparation changes (e.g. new filter parameter).
+ */
+class BScanFrameCache
+{
+public:
+	typedef std::shared_ptr<const CVImageWidget::PreparedImage> FramePtr;
+
+	explicit BScanFrameCache(std::size_t capacity = 8, std::size_t prefetchAhead = 4);
+	~BScanFrameCache();
+
+	BScanFrameCache(const BScanFrameCache&) = delete;
+	BScanFrameCache& operator=(const BScanFrameCache&) = delete;
+
+	FramePtr getFrame(const std::shared_ptr<const OctData::BScan>& bscan);
+	void     addFrame(const std::shared_ptr<const OctData::BScan>& bscan, FramePtr frame);
+
+	/// prepare the B-scans after bscanNr in direction (+1/-1) and the one before, pending jobs of an older call are dropped
+	void prefetch(const std::shared_ptr<const OctData::Series>& series, std::size_t bscanNr, int direction, const CVImageWidget::ImagePreparer& preparer);
+
+	/// remove all frames and pending jobs, waits until a running preparation is finished
+	void invalidate();
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<const OctData::BScan> bscan;
+		FramePtr frame;
+	};
+
+	const std::size_t capacity;
+	const std::size_t prefetchAhead;
+
+	std::list<Entry>                                  frames;  // most recently used first
+	std::deque<std::shared_ptr<const OctData::BScan>> jobs;
+	CVImageWidget::ImagePreparer                      preparer;
+
+	std::size_t generation = 0;
+	bool        working    = false;
+	bool        stop       = false;
+
+	std::mutex              mutex;
+	std::condition_variable jobCondition;
+	std::condition_variable idleCondition;
+	std::thread             worker;
+
+	void run();
+	bool containsFrame(const OctData::BScan* bscan) const;
+	void insertFrame(const std::shared_ptr<const OctData::BScan>& bscan, FramePtr frame);
+};
+
+#endif // BSCANFRAMECACHE_H
@@ -28,6 +28,8 @@
 #include<QFileDialog>
 #include<QGraphicsView>
 
+#include "bscanframecache.h"
+
 #include<oct_cpp_framework/cvmat/treestructbin.h>
 
 #include<octdata/datastruct/series.h>
@@ -82,6 +84,7 @@ namespace
 BScanMarkerWidget::BScanMarkerWidget()
 : CVImageWidget()
 , markerManger(OctMarkerManager::getInstance())
+, frameCache(std::make_unique<BScanFrameCache>())
 {
 	
 	OctDataManager& octdataManager = OctDataManager::getInstance();
@@ -363,7 +366,7 @@ void BScanMarkerWidget::imageChanged()
 		else
 			bscanAspectRatio = 1.0;
 
-		showImage(actBScan->getImage());
+		showBScanImage(actBScan);
 		updateAspectRatio();
 	}
 	else
@@ -384,8 +387,52 @@ void BScanMarkerWidget::leaveEvent(QEvent* event)
 }
 
 
+void BScanMarkerWidget::showBScanImage(const std::shared_ptr<const OctData::BScan>& bscan)
+{
+	BScanFrameCache::FramePtr frame = frameCache->getFrame(bscan);
+	if(!frame)
+	{
+		std::shared_ptr<PreparedImage> newFrame = std::make_shared<PreparedImage>();
+		if(getImagePreparer()(bscan->getImage(), *newFrame))
+		{
+			frameCache->addFrame(bscan, newFrame);
+			frame = newFrame;
+		}
+	}
+
+	if(frame)
+	{
+		showPreparedImage(*frame);
+		updateImageView(frame->cvImage.cols, frame->cvImage.rows);
+	}
+	else
+		showImage(bscan->getImage());
+
+	// prepare the next B-scans in scroll direction while the user looks at this one
+	const int bscanNr = markerManger.getActBScanNum();
+	if(bscanNr >= 0)
+		frameCache->prefetch(markerManger.getSeries(), static_cast<std::size_t>(bscanNr), bscanNr - lastShowedBScanNr, getImagePreparer());
+	lastShowedBScanNr = bscanNr;
+}
+
+
+void BScanMarkerWidget::setImageFilter(const FilterImage* imageFilter)
+{
+	frameCache->invalidate();
+	CVImageWidget::setImageFilter(imageFilter);
+}
+
+void BScanMarkerWidget::imageParameterChanged()
+{
+	frameCache->invalidate();
+	CVImageWidget::imageParameterChanged();
+}
+
+
 void BScanMarkerWidget::cscanLoaded()
 {
+	frameCache->invalidate();
+	lastShowedBScanNr = -1;
 	imageChanged();
 }
 
@@ -704,12 +751,16 @@ void BScanMarkerWidget::updateGraphicsViewSize()
 void BScanMarkerWidget::showImage(const cv::Mat& image)
 {
 	CVImageWidget::showImage(image);
+	updateImageView(image.cols, image.rows);
+}
 
+void BScanMarkerWidget::updateImageView(int imageCols, int imageRows)
+{
 	triggerAutoImageFit();
 
 	GraphicsView* gvConvert = dynamic_cast<GraphicsView*>(gv);
 	if(gvConvert)
-		gvConvert->setImageSize(image.cols, image.rows);
+		gvConvert->setImageSize(imageCols, imageRows);
 	updateGraphicsViewSize();
 }
 
@@ -23,6 +23,8 @@
 
 #include <QPoint>
 
+#include <memory>
+
 namespace OctData { class BScan; }
 
 class QWheelEvent;
@@ -37,6 +39,8 @@ class ContureSegment;
 
 class PaintMarker;
 
+class BScanFrameCache;
+
 /**
  * @ingroup Widget
  * @brief
@@ -57,6 +61,9 @@ class BScanMarkerWidget : public CVImageWidget
 // 	const OctData::BScan*                   actBscan           = nullptr;
 	const PaintMarker*                      paintMarker        = nullptr;
 
+	std::unique_ptr<BScanFrameCache> frameCache;
+	int lastShowedBScanNr = -1;
+
 	bool controlUsed = false;
 	double bscanAspectRatio = 1.;
 	void fitAspectRatio();
@@ -73,6 +80,9 @@ class BScanMarkerWidget : public CVImageWidget
 	void paintConture(QPainter& painter, const std::vector<ContureSegment>& contours) const;
 	void paintSegmentations(QPainter& segPainter, const ScaleFactor& scaleFactor) const;
 
+	void showBScanImage(const std::shared_ptr<const OctData::BScan>& bscan);
+	void updateImageView(int imageCols, int imageRows);
+
 
 	void transformCoordWidget2Img(int xWidget, int yWidget, int& xImg, int& yImg)
 	{
@@ -90,6 +100,8 @@ public:
 
 	void setPaintMarker(const PaintMarker* pm);
 
+	void setImageFilter(const FilterImage* imageFilter) override;
+
 protected:
 	void paintEvent(QPaintEvent* event) override;
 	void contextMenuEvent(QContextMenuEvent* event) override;
@@ -122,6 +134,8 @@ private slots:
 
 	void updateAspectRatio();
 
+	void imageParameterChanged() override;
+
 public slots:
 	virtual void saveRawImage();
 	virtual void saveRawMat  ();
@@ -90,64 +90,96 @@ void CVImageWidget::showImage(const cv::Mat& image)
 {
 	if(image.empty())
 		cvImage = cv::Mat();
-	else
+	else if(!convertImage(image, cvImage, grayCvImage, floatGrayTransform, grayTransformA, grayTransformB))
+		return;
+
+	cvImage2qtImage();
+}
+
+void CVImageWidget::showPreparedImage(const PreparedImage& image)
+{
+	cvImage     = image.cvImage;
+	outputImage = image.outputImage;
+	grayCvImage = image.grayCvImage;
+
+	outputImage2qtImage();
+}
+
+CVImageWidget::ImagePreparer CVImageWidget::getImagePreparer() const
+{
+	const FloatGrayTransform transform = floatGrayTransform;
+	const double             a         = grayTransformA;
+	const double             b         = grayTransformB;
+	const FilterImage*       filter    = imageFilter;
+
+	return [transform, a, b, filter](const cv::Mat& image, PreparedImage& prepared)
+	{
+		if(image.empty() || !convertImage(image, prepared.cvImage, prepared.grayCvImage, transform, a, b))
+			return false;
+
+		if(filter)
+			filter->applyFilter(prepared.cvImage, prepared.outputImage);
+		else
+			prepared.outputImage = prepared.cvImage;
+		return true;
+	};
+}
+
+bool CVImageWidget::convertImage(const cv::Mat& image, cv::Mat& cvImage, bool& grayCvImage, FloatGrayTransform floatGrayTransform, double grayTransformA, double grayTransformB)
+{
+	// Convert the image to the RGB888 format
+	switch(image.type())
 	{
-		// Convert the image to the RGB888 format
-		switch(image.type())
+		case CV_8UC1:
+			// cvtColor(image, cvImage, CV_GRAY2RGB);
+			cvImage = image.clone();
+			grayCvImage = true;
+			break;
+		case CV_8UC3:
+			cvtColor(image, cvImage, cv::COLOR_BGR2RGB);
+			grayCvImage = false;
+			break;
+		case CV_32FC1:
+		case CV_64FC1:
 		{
-			case CV_8UC1:
-				// cvtColor(image, cvImage, CV_GRAY2RGB);
-				cvImage = image.clone();
-				grayCvImage = true;
-				break;
-			case CV_8UC3:
-				cvtColor(image, cvImage, cv::COLOR_BGR2RGB);
-				grayCvImage = false;
-				break;
-			case CV_32FC1:
-			case CV_64FC1:
-			{
-				std::cout << "1 Channels: " << image.channels() << "\tgr: " << image.rows << " x " << image.cols << std::endl;
+			std::cout << "1 Channels: " << image.channels() << "\tgr: " << image.rows << " x " << image.cols << std::endl;
 
-				switch(floatGrayTransform)
+			switch(floatGrayTransform)
+			{
+				case FloatGrayTransform::Auto:
 				{
-					case FloatGrayTransform::Auto:
-					{
-						double min, max;
-						cv::minMaxLoc(image, &min, &max);
-						if(min == max)
-							max = min+1;
-						image.convertTo(cvImage, cv::DataType<uint8_t>::type, 255.0/(max-min), -255.0*min/(max-min));
-						break;
-					}
-					case FloatGrayTransform::Fix:
-						image.convertTo(cvImage, cv::DataType<uint8_t>::type, grayTransformA, grayTransformB);
-						break;
-					case FloatGrayTransform::ZeroToOne:
-						image.convertTo(cvImage, cv::DataType<uint8_t>::type, 255.0, 0);
-						break;
+					double min, max;
+					cv::minMaxLoc(image, &min, &max);
+					if(min == max)
+						max = min+1;
+					image.convertTo(cvImage, cv::DataType<uint8_t>::type, 255.0/(max-min), -255.0*min/(max-min));
+					break;
 				}
+				case FloatGrayTransform::Fix:
+					image.convertTo(cvImage, cv::DataType<uint8_t>::type, grayTransformA, grayTransformB);
+					break;
+				case FloatGrayTransform::ZeroToOne:
+					image.convertTo(cvImage, cv::DataType<uint8_t>::type, 255.0, 0);
+					break;
+			}
 
 
-				std::cout << "2 Channels: " << cvImage.channels() << "\tgr: " << cvImage.rows << " x " << cvImage.cols << std::endl;
+			std::cout << "2 Channels: " << cvImage.channels() << "\tgr: " << cvImage.rows << " x " << cvImage.cols << std::endl;
 
-				if(cvImage.channels() == 1)
-					cv::cvtColor(cvImage, cvImage, cv::COLOR_GRAY2BGR);
+			if(cvImage.channels() == 1)
+				cv::cvtColor(cvImage, cvImage, cv::COLOR_GRAY2BGR);
 
 
-				std::cout << "3 Channels: " << cvImage.channels() << "\tgr: " << cvImage.rows << " x " << cvImage.cols << std::endl;
+			std::cout << "3 Channels: " << cvImage.channels() << "\tgr: " << cvImage.rows << " x " << cvImage.cols << std::endl;
 
-				break;
-			}
-			default:
-				qDebug("unhandeld opencv image format %d", image.type());
-				return;
+			break;
 		}
-
-		// QImage needs the data to be stored continuously in memory
+		default:
+			qDebug("unhandeld opencv image format %d", image.type());
+			return false;
 	}
 
-	cvImage2qtImage();
+	return true;
 }
 
 void CVImageWidget::updateScaleFactor()
@@ -261,11 +293,25 @@ void CVImageWidget::cvImage2qtImage()
 		return;
 	}
 
+	// the old output image can be shared with a prepared image, don't write into it
+	outputImage.release();
 	if(imageFilter)
 		imageFilter->applyFilter(cvImage, outputImage);
 	else
 		outputImage = cvImage;
 
+	outputImage2qtImage();
+}
+
+
+void CVImageWidget::outputImage2qtImage()
+{
+	if(outputImage.empty())
+	{
+		qtImage = QImage();
+		return;
+	}
+
 	cvImage2qtImage(outputImage, qtImage);
 
 	switch(scaleMethod)
@@ -23,6 +23,8 @@
 #include <QWidget>
 #include <QImage>
 
+#include <functional>
+
 #include <opencv2/opencv.hpp>
 
 #include<data_structure/scalefactor.h>
@@ -63,6 +65,16 @@ class CVImageWidget : public QWidget
 public:
 	enum class FloatGrayTransform { Auto, Fix, ZeroToOne };
 
+	/// image converted to 8 bit gray or RGB and with applied image filter, ready to show
+	struct PreparedImage
+	{
+		cv::Mat cvImage;
+		cv::Mat outputImage;
+		bool    grayCvImage = true;
+	};
+	/// prepare an image with the settings of the widget, can be called from another thread
+	typedef std::function<bool(const cv::Mat& image, PreparedImage& prepared)> ImagePreparer;
+
 	explicit CVImageWidget(QWidget *parent = 0);
 	~CVImageWidget() override;
 
@@ -89,7 +101,11 @@ public:
 	void setGrayTransformValueA(double val)                     { grayTransformA = val; }
 	void setGrayTransformValueB(double val)                     { grayTransformB = val; }
 
-	void setImageFilter(const FilterImage* imageFilter);
+	virtual void setImageFilter(const FilterImage* imageFilter);
+	const FilterImage* getImageFilter()                   const { return imageFilter; }
+
+	ImagePreparer getImagePreparer() const;
+	void showPreparedImage(const PreparedImage& image);
 
 	static void drawScaled(const QImage& image, QPainter& painter, const QRect* rect, const ScaleFactor& sf);
 protected:
@@ -110,8 +126,10 @@ protected:
 	int fileDialog(QString& filename);
 
 	void cvImage2qtImage();
+	void outputImage2qtImage();
 	void updateScaleFactor();
 	static void cvImage2qtImage(const cv::Mat& cvImage, QImage& qimage);
+	static bool convertImage(const cv::Mat& image, cv::Mat& cvImage, bool& grayCvImage, FloatGrayTransform transform, double grayTransformA, double grayTransformB);
 
 	void setZoomInternal(double factor)                          { if(scaleFactorConfig != factor && factor <= 25 && factor > 0) { scaleFactorConfig = factor; updateScaleFactorXY(); zoomChanged(factor); cvImage2qtImage(); } }
 	double getFactorFitImage2Parent();
@@ -132,8 +150,8 @@ public slots:
 
 	void setAspectRatio(double v);
 
-private slots:
-	void imageParameterChanged();
+protected slots:
+	virtual void imageParameterChanged();
 
 signals:
 	void zoomChanged(double);
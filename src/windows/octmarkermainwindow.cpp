@@ -380,6 +380,7 @@ void OCTMarkerMainWindow::setupMenu()
 	optionsMenu->addSeparator();
 
 	optionsMenu->addAction(ProgramOptions::autoSaveOctMarkers.getAction());
+	optionsMenu->addAction(ProgramOptions::undoMemoryBudgetMiB.getInputDialogAction());
 
 
 	QMenu* optionsMenuMarkersFileFormat = new QMenu(this);
@@ -393,6 +394,8 @@ void OCTMarkerMainWindow::setupMenu()
 	addMenuProgramOptionGroup(tr("JSON"), ProgramOptions::defaultFileformatOctMarkers, optionsMenuMarkersFileFormat, markerFFjson  , markersFileFormatGroup, this);
 	static SendInt markerFFinfo(OctMarkerIO::fileformat2Int(OctMarkerFileformat::INFO));
 	addMenuProgramOptionGroup(tr("INFO"), ProgramOptions::defaultFileformatOctMarkers, optionsMenuMarkersFileFormat, markerFFinfo  , markersFileFormatGroup, this);
+	static SendInt markerFFbinary(OctMarkerIO::fileformat2Int(OctMarkerFileformat::Binary));
+	addMenuProgramOptionGroup(tr("Binary"), ProgramOptions::defaultFileformatOctMarkers, optionsMenuMarkersFileFormat, markerFFbinary, markersFileFormatGroup, this);
 
 	optionsMenu->addSeparator();
 	optionsMenu->addAction(ProgramOptions::getResetAction());
@@ -503,6 +506,18 @@ void OCTMarkerMainWindow::setupStatusBar()
 
 	statusBar()->addPermanentWidget(loadProgressBar);
 
+	connect(&octDataManager, &OctDataManager::seriesSLODistanceMapCalculation, this, &OCTMarkerMainWindow::distMapStatusSlot);
+	connect(&octDataManager, &OctDataManager::seriesSLODistanceMapProgress   , this, &OCTMarkerMainWindow::distMapProgress  );
+
+	distMapProgressBar = new QProgressBar;
+	distMapProgressBar->setFixedWidth(200);
+	distMapProgressBar->setMinimum(0);
+	distMapProgressBar->setMaximum(100);
+	distMapProgressBar->setFormat(tr("SLO distance map %p%"));
+	distMapProgressBar->setVisible(false);
+
+	statusBar()->addPermanentWidget(distMapProgressBar);
+
 // 	MouseCoordStatus* mouseStatus = new MouseCoordStatus(bscanMarkerWidget);
 // 	statusBar()->addPermanentWidget(mouseStatus);
 }
@@ -754,11 +769,13 @@ void OCTMarkerMainWindow::setMarkersStringList(QStringList& filters)
 	const char* josnExt = OctMarkerIO::getFileExtension(OctMarkerFileformat::Json);
 	const char*  xmlExt = OctMarkerIO::getFileExtension(OctMarkerFileformat::XML);
 	const char* infoExt = OctMarkerIO::getFileExtension(OctMarkerFileformat::INFO);
+	const char*  binExt = OctMarkerIO::getFileExtension(OctMarkerFileformat::Binary);
 	
-	filters << tr("OCT Markers")+QString(" (*.%1 *.%2 *.%3)").arg(josnExt).arg(xmlExt).arg(infoExt);
+	filters << tr("OCT Markers")+QString(" (*.%1 *.%2 *.%3 *.%4)").arg(josnExt).arg(xmlExt).arg(infoExt).arg(binExt);
 	filters << tr("OCT Markers Json file")+QString(" (*.%1)").arg(josnExt);
 	filters << tr("OCT Markers XML file" )+QString(" (*.%1)").arg(xmlExt);
 	filters << tr("OCT Markers INFO file")+QString(" (*.%1)").arg(infoExt);
+	filters << tr("OCT Markers binary file")+QString(" (*.%1)").arg(binExt);
 }
 
 namespace
@@ -769,7 +786,7 @@ namespace
 		OCTMarkerMainWindow::setMarkersStringList(filters);
 		int index = filters.indexOf(filter);
 		
-		static const OctMarkerFileformat formats[] = {OctMarkerFileformat::Json, OctMarkerFileformat::XML, OctMarkerFileformat::INFO};
+		static const OctMarkerFileformat formats[] = {OctMarkerFileformat::Json, OctMarkerFileformat::XML, OctMarkerFileformat::INFO, OctMarkerFileformat::Binary};
 		
 		if(index == 0)
 		   return OctMarkerFileformat::Auto;
@@ -921,6 +938,7 @@ void OCTMarkerMainWindow::closeEvent(QCloseEvent* e)
 		OctDataManager::getInstance().saveMarkersDefault();
 		if(!OctDataManager::getInstance().checkAndAskSaveBeforContinue())
 			return e->ignore();
+		OctDataManager::getInstance().waitForMarkerSaves();
 	};
 
 	std::string errorStr;
@@ -977,6 +995,17 @@ void OCTMarkerMainWindow::loadFileProgress(double frac)
 	loadProgressBar->setValue(static_cast<int>(frac*100));
 }
 
+void OCTMarkerMainWindow::distMapStatusSlot(bool calculating)
+{
+	distMapProgressBar->setValue(0);
+	distMapProgressBar->setVisible(calculating);
+}
+
+void OCTMarkerMainWindow::distMapProgress(double frac)
+{
+	distMapProgressBar->setValue(static_cast<int>(frac*100));
+}
+
 
 void OCTMarkerMainWindow::screenshot()
 {
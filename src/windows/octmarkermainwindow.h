@@ -68,6 +68,7 @@ class OCTMarkerMainWindow : public QMainWindow
 	PaintMarker* pmm = nullptr;
 
 	QProgressBar* loadProgressBar  = nullptr;
+	QProgressBar* distMapProgressBar = nullptr;
 
 	OctMarkerActions generalMarkerActions;
 	QList<QAction*> markerActions;
@@ -107,6 +108,9 @@ private slots:
 	void loadFileStatusSlot(bool loading);
 	void loadFileProgress(double frac);
 
+	void distMapStatusSlot(bool calculating);
+	void distMapProgress(double frac);
+
 	void triggerSaveMarkersDefaultCatchErrors();
 
 public slots:
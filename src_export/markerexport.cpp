@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "markerexport.h"
+
+#include<vector>
+#include<map>
+#include<string>
+#include<algorithm>
+#include<stdexcept>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <oct_cpp_framework/cvmat/cvmattreestruct.h>
+#include <oct_cpp_framework/cvmat/treestructbin.h>
+
+#include <octdata/datastruct/segmentationlines.h>
+
+#include <manager/octmarkerio.h>
+#include <data_structure/simplematcompress.h>
+#include <markermodules/bscanlayersegmentation/bscanlayersegptree.h>
+#include <markermodules/bscanlayersegmentation/layersegmentationio.h>
+#include <markermodules/bscanintervalmarker/bscanintervalptree.h>
+
+
+namespace bpt = boost::property_tree;
+namespace fs  = std::filesystem;
+
+
+namespace
+{
+	/// dense form of the markers of one series
+	class SeriesExport
+	{
+		struct Mask
+		{
+			int               bscanId;
+			SimpleMatCompress mat;
+		};
+
+		struct Interval
+		{
+			int     bscanId;
+			int     start;
+			int     end;
+			uint8_t markerIndex;
+		};
+
+		struct IntervalCollection
+		{
+			std::vector<std::string> markerNames { "undefined" };
+			std::vector<Interval>    intervals;
+
+			uint8_t getMarkerIndex(const std::string& name);
+		};
+
+		std::vector<OctData::Segmentationlines>        lines;
+		std::vector<bool>                              linesLoaded;
+		std::map<std::string, std::vector<Mask>>       masks;
+		std::map<std::string, IntervalCollection>      intervalCollections;
+
+		std::size_t numBscans = 0;
+		std::size_t width     = 0;
+
+		void addBScanId(int bscanId)                                { numBscans = std::max(numBscans, static_cast<std::size_t>(bscanId) + 1); }
+
+		void readLayerSegmentation(const bpt::ptree& moduleNode);
+		void readMasks            (const bpt::ptree& moduleNode);
+		void readIntervals        (const bpt::ptree& moduleNode);
+
+		void writeMasks    (CppFW::CVMatTree& tree) const;
+		void writeIntervals(CppFW::CVMatTree& tree) const;
+
+	public:
+		explicit SeriesExport(const bpt::ptree& seriesNode);
+
+		std::size_t getNumBscans() const                            { return numBscans; }
+
+		void write(const fs::path& filename) const;
+	};
+
+
+	uint8_t SeriesExport::IntervalCollection::getMarkerIndex(const std::string& name)
+	{
+		std::vector<std::string>::const_iterator it = std::find(markerNames.begin(), markerNames.end(), name);
+		if(it != markerNames.end())
+			return static_cast<uint8_t>(it - markerNames.begin());
+
+		if(markerNames.size() > 255)
+			throw std::runtime_error("too many interval marker classes");
+		markerNames.push_back(name);
+		return static_cast<uint8_t>(markerNames.size() - 1);
+	}
+
+
+	SeriesExport::SeriesExport(const bpt::ptree& seriesNode)
+	{
+		boost::optional<const bpt::ptree&> layerSegNode = seriesNode.get_child_optional("LayerSegmentation");
+		if(layerSegNode)
+			readLayerSegmentation(*layerSegNode);
+
+		boost::optional<const bpt::ptree&> segmentationNode = seriesNode.get_child_optional("SegmentationMarker");
+		if(segmentationNode)
+			readMasks(*segmentationNode);
+
+		boost::optional<const bpt::ptree&> intervalNode = seriesNode.get_child_optional("IntervalMarker");
+		if(intervalNode)
+			readIntervals(*intervalNode);
+	}
+
+	void SeriesExport::readLayerSegmentation(const bpt::ptree& moduleNode)
+	{
+		for(const std::pair<const std::string, bpt::ptree>& bscanPair : moduleNode)
+		{
+			if(bscanPair.first != "BScan")
+				continue;
+
+			const int bscanId = bscanPair.second.get<int>("ID", -1);
+			boost::optional<const bpt::ptree&> linesNode = bscanPair.second.get_child_optional("Lines");
+			if(bscanId < 0 || !linesNode)
+				continue;
+
+			addBScanId(bscanId);
+			if(lines.size() < numBscans)
+			{
+				lines      .resize(numBscans);
+				linesLoaded.resize(numBscans, false);
+			}
+
+			OctData::Segmentationlines& bscanLines = lines[static_cast<std::size_t>(bscanId)];
+			for(const std::pair<const std::string, bpt::ptree>& linePair : *linesNode)
+			{
+				OctData::Segmentationlines::SegmentlineType type;
+				if(!BScanLayerSegPTree::getSeglineType(linePair.first, type))
+					continue;
+
+				OctData::Segmentationlines::Segmentline& line = bscanLines.getSegmentLine(type);
+				BScanLayerSegPTree::parseSegline(linePair.second, line);
+				width = std::max(width, line.size());
+				linesLoaded[static_cast<std::size_t>(bscanId)] = true;
+			}
+		}
+	}
+
+	void SeriesExport::readMasks(const bpt::ptree& moduleNode)
+	{
+		std::string decodeBuffer;
+		for(const std::pair<const std::string, bpt::ptree>& maskNodePair : moduleNode)
+		{
+			std::vector<Mask> bscanMasks;
+			for(const std::pair<const std::string, bpt::ptree>& bscanPair : maskNodePair.second)
+			{
+				if(bscanPair.first != "BScan")
+					continue;
+
+				const int bscanId = bscanPair.second.get<int>("ID", -1);
+				boost::optional<const bpt::ptree&> matCompressNode = bscanPair.second.get_child_optional("matCompress");
+				if(bscanId < 0 || !matCompressNode)
+					continue;
+
+				Mask mask;
+				mask.bscanId = bscanId;
+				if(!mask.mat.fromString(matCompressNode->data(), decodeBuffer))
+					continue;
+
+				// all masks need the size of the first one
+				if(!bscanMasks.empty() && (mask.mat.getRows() != bscanMasks.front().mat.getRows() || mask.mat.getCols() != bscanMasks.front().mat.getCols()))
+					continue;
+
+				addBScanId(bscanId);
+				bscanMasks.push_back(std::move(mask));
+			}
+
+			if(!bscanMasks.empty())
+				masks.emplace(maskNodePair.first, std::move(bscanMasks));
+		}
+	}
+
+	void SeriesExport::readIntervals(const bpt::ptree& moduleNode)
+	{
+		for(const std::pair<const std::string, bpt::ptree>& collectionPair : moduleNode)
+		{
+			if(collectionPair.second.find("BScan") == collectionPair.second.not_found())
+				continue;
+
+			IntervalCollection& collection = intervalCollections[collectionPair.first];
+			BScanIntervalPTree::readIntervals(moduleNode, collectionPair.first, [&](int bscanId, int start, int end, const std::string& markerClass)
+				{
+					if(bscanId < 0 || end < start || end < 0)
+						return;
+
+					addBScanId(bscanId);
+					width = std::max(width, static_cast<std::size_t>(end) + 1);
+					collection.intervals.push_back(Interval{bscanId, start, end, collection.getMarkerIndex(markerClass)});
+				});
+		}
+	}
+
+
+	void SeriesExport::writeMasks(CppFW::CVMatTree& tree) const
+	{
+		for(const std::pair<const std::string, std::vector<Mask>>& maskPair : masks)
+		{
+			const int rows = maskPair.second.front().mat.getRows();
+			const int cols = maskPair.second.front().mat.getCols();
+
+			cv::Mat& mat = tree.getDirNode(maskPair.first).getMat();
+			mat.create(static_cast<int>(numBscans)*rows, cols, cv::DataType<uint8_t>::type);
+			mat = cv::Scalar(0);
+
+			for(const Mask& mask : maskPair.second)
+				mask.mat.writeToMat(mat.ptr<uint8_t>(mask.bscanId*rows), rows, cols);
+		}
+	}
+
+	void SeriesExport::writeIntervals(CppFW::CVMatTree& tree) const
+	{
+		for(const std::pair<const std::string, IntervalCollection>& collectionPair : intervalCollections)
+		{
+			const IntervalCollection& collection = collectionPair.second;
+			CppFW::CVMatTree& collectionNode = tree.getDirNode(collectionPair.first);
+
+			CppFW::CVMatTree& markerNode = collectionNode.getDirNode("marker");
+			for(const std::string& name : collection.markerNames)
+				markerNode.newListNode().getString() = name;
+
+			cv::Mat& fieldMat = collectionNode.getDirNode("field").getMat();
+			fieldMat.create(static_cast<int>(numBscans), static_cast<int>(width), cv::DataType<uint8_t>::type);
+			fieldMat = cv::Scalar(0);
+
+			for(const Interval& interval : collection.intervals)
+			{
+				uint8_t* row = fieldMat.ptr<uint8_t>(interval.bscanId);
+				std::fill(row + std::max(interval.start, 0), row + interval.end + 1, interval.markerIndex);
+			}
+		}
+	}
+
+	void SeriesExport::write(const fs::path& filename) const
+	{
+		CppFW::CVMatTree tree;
+
+		if(!lines.empty())
+		{
+			std::vector<const OctData::Segmentationlines*> bscanLines(numBscans, nullptr);
+			for(std::size_t bscan = 0; bscan < lines.size(); ++bscan)
+				if(linesLoaded[bscan])
+					bscanLines[bscan] = &lines[bscan];
+
+			LayerSegmentationIO::fillSegmentationTree(tree.getDirNode("LayerSegmentation"), bscanLines, width);
+
+			fs::path mapFilename = filename;
+			mapFilename.replace_extension(".segmap");
+			if(!LayerSegmentationIO::saveSegmentation2Map(bscanLines, width, mapFilename.generic_string()))
+				throw std::runtime_error("can't write " + mapFilename.generic_string());
+		}
+
+		if(!masks.empty())
+			writeMasks(tree.getDirNode("SegmentationMarker"));
+
+		if(!intervalCollections.empty())
+			writeIntervals(tree.getDirNode("marker_maps"));
+
+		if(!CppFW::CVMatTreeStructBin::writeBin(filename.generic_string(), tree))
+			throw std::runtime_error("can't write " + filename.generic_string());
+	}
+
+
+	template<typename Fun>
+	void forEachChild(const bpt::ptree& node, const char* name, Fun fun)
+	{
+		for(const std::pair<const std::string, bpt::ptree>& child : node)
+			if(child.first == name)
+				fun(child.second);
+	}
+}
+
+
+bool MarkerExport::isMarkerFile(const fs::path& file)
+{
+	switch(OctMarkerIO::getFormatFromExtension(file))
+	{
+		case OctMarkerFileformat::Json:
+		case OctMarkerFileformat::XML:
+		case OctMarkerFileformat::INFO:
+		case OctMarkerFileformat::Binary:
+			return true;
+		case OctMarkerFileformat::Auto:
+		case OctMarkerFileformat::Unknown:
+		case OctMarkerFileformat::NoExtension:
+			break;
+	}
+	return false;
+}
+
+
+MarkerExport::Result MarkerExport::exportFile(const fs::path& markerFile, const fs::path& outputBase)
+{
+	Result result;
+	result.bytesRead = fs::file_size(markerFile);
+
+	bpt::ptree markerTree;
+	OctMarkerIO markerIO(&markerTree);
+	if(!markerIO.loadMarkers(markerFile, OctMarkerFileformat::Auto))
+		throw std::runtime_error("can't read marker file " + markerFile.generic_string());
+
+	std::vector<const bpt::ptree*> seriesNodes;
+	forEachChild(markerTree, "Patient", [&](const bpt::ptree& patientNode)
+	{
+		forEachChild(patientNode, "Study", [&](const bpt::ptree& studyNode)
+		{
+			forEachChild(studyNode, "Series", [&](const bpt::ptree& seriesNode) { seriesNodes.push_back(&seriesNode); });
+		});
+	});
+
+	if(outputBase.has_parent_path())
+		fs::create_directories(outputBase.parent_path());
+
+	for(std::size_t seriesNr = 0; seriesNr < seriesNodes.size(); ++seriesNr)
+	{
+		const SeriesExport seriesExport(*seriesNodes[seriesNr]);
+		if(seriesExport.getNumBscans() == 0)
+			continue;
+
+		fs::path filename = outputBase;
+		if(seriesNodes.size() > 1)
+			filename += "_" + std::to_string(seriesNr);
+		filename += ".bin";
+
+		seriesExport.write(filename);
+
+		++result.series;
+		result.bscans += seriesExport.getNumBscans();
+	}
+
+	return result;
+}
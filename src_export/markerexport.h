@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MARKEREXPORT_H
+#define MARKEREXPORT_H
+
+#include<cstdint>
+#include<filesystem>
+
+/**
+ * @brief Converts the markers of a marker file into dense arrays, without the marker modules and the gui
+ *
+ * One CVMatTree bin file is written per series (outputBase.bin, with more than one series outputBase_<nr>.bin):
+ *  - LayerSegmentation/<segline>            float [B-scans x width], layout of LayerSegmentationIO
+ *    (additionally as memory mappable file outputBase.segmap, see LayerSegmentationIO::saveSegmentation2Map)
+ *  - SegmentationMarker/<name>              uint8 [B-scans*rows x cols], the masks stacked
+ *  - marker_maps/<collection>/field|marker  uint8 [B-scans x width], layout of ImportIntervalMarker
+ *
+ * The number of B-scans and the width are taken from the markers, the OCT file is not read.
+ */
+class MarkerExport
+{
+public:
+	struct Result
+	{
+		std::size_t    series    = 0;
+		std::size_t    bscans    = 0;
+		std::uintmax_t bytesRead = 0;
+	};
+
+	static bool isMarkerFile(const std::filesystem::path& file);
+
+	/// throws on read and write errors
+	static Result exportFile(const std::filesystem::path& markerFile, const std::filesystem::path& outputBase);
+};
+
+#endif // MARKEREXPORT_H
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2018 Kay Gawlik <kaydev@amarunet.de> <kay.gawlik@beuth-hochschule.de> <kay.gawlik@charite.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * octmarker-export [-j threads] <input directory> <output directory>
+ *
+ * Converts all marker files below the input directory into dense arrays (see MarkerExport),
+ * the directory structure is kept. Works without Qt, the files are processed by a pool of threads.
+ */
+
+#include<iostream>
+#include<iomanip>
+#include<vector>
+#include<string>
+#include<thread>
+#include<mutex>
+#include<atomic>
+#include<chrono>
+#include<algorithm>
+#include<filesystem>
+
+#include "markerexport.h"
+
+namespace fs = std::filesystem;
+
+
+namespace
+{
+	void printUsage(const char* programName)
+	{
+		std::cerr << "usage: " << programName << " [-j threads] <input directory> <output directory>\n";
+	}
+
+	void printProgress(std::size_t filesDone, std::size_t numFiles, std::uintmax_t bytesRead, std::size_t bscans, double seconds)
+	{
+		const double filesPerSecond = seconds > 0 ? static_cast<double>(filesDone)/seconds               : 0.;
+		const double mbPerSecond    = seconds > 0 ? static_cast<double>(bytesRead)/seconds/(1024.*1024.) : 0.;
+
+		std::cout << filesDone << '/' << numFiles << " files, "
+		          << bscans << " B-scans, "
+		          << std::fixed << std::setprecision(1) << filesPerSecond << " files/s, "
+		          << mbPerSecond << " MB/s" << std::endl;
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	std::size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::string> directories;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if(arg == "-j" && i+1 < argc)
+			numThreads = std::max<std::size_t>(1, std::stoul(argv[++i]));
+		else
+			directories.push_back(arg);
+	}
+
+	if(directories.size() != 2)
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	const fs::path inputDir (directories[0]);
+	const fs::path outputDir(directories[1]);
+
+	std::vector<fs::path> markerFiles;
+	for(const fs::directory_entry& entry : fs::recursive_directory_iterator(inputDir))
+		if(entry.is_regular_file() && MarkerExport::isMarkerFile(entry.path()))
+			markerFiles.push_back(entry.path());
+	std::sort(markerFiles.begin(), markerFiles.end());
+
+	const std::size_t numFiles = markerFiles.size();
+	numThreads = std::min(numThreads, std::max<std::size_t>(numFiles, 1));
+	std::cout << "export " << numFiles << " marker files with " << numThreads << " threads" << std::endl;
+
+	std::atomic<std::size_t>    nextFile   (0);
+	std::atomic<std::size_t>    filesDone  (0);
+	std::atomic<std::size_t>    filesFailed(0);
+	std::atomic<std::size_t>    bscansDone (0);
+	std::atomic<std::uintmax_t> bytesRead  (0);
+	std::mutex errorMutex;
+
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	auto exportFiles = [&]()
+	{
+		for(std::size_t fileNr = nextFile++; fileNr < numFiles; fileNr = nextFile++)
+		{
+			const fs::path& markerFile = markerFiles[fileNr];
+			try
+			{
+				fs::path outputBase = outputDir/fs::relative(markerFile, inputDir);
+				outputBase.replace_extension();
+
+				const MarkerExport::Result result = MarkerExport::exportFile(markerFile, outputBase);
+				bscansDone += result.bscans;
+				bytesRead  += result.bytesRead;
+			}
+			catch(const std::exception& e)
+			{
+				++filesFailed;
+				std::lock_guard<std::mutex> lock(errorMutex);
+				std::cerr << markerFile.generic_string() << ": " << e.what() << std::endl;
+			}
+			++filesDone;
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(std::size_t i = 0; i < numThreads; ++i)
+		workers.emplace_back(exportFiles);
+
+	auto elapsedSeconds = [&startTime]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count(); };
+
+	std::chrono::steady_clock::time_point nextProgress = startTime + std::chrono::seconds(1);
+	while(filesDone < numFiles)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		if(std::chrono::steady_clock::now() >= nextProgress)
+		{
+			printProgress(filesDone, numFiles, bytesRead, bscansDone, elapsedSeconds());
+			nextProgress += std::chrono::seconds(1);
+		}
+	}
+
+	for(std::thread& worker : workers)
+		worker.join();
+
+	printProgress(filesDone, numFiles, bytesRead, bscansDone, elapsedSeconds());
+	if(filesFailed > 0)
+		std::cerr << filesFailed << " files failed" << std::endl;
+
+	return filesFailed > 0 ? 2 : 0;
+}
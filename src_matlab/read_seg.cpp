@@ -10,33 +10,108 @@
 #include <boost/property_tree/xml_parser.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
-#include <boost/archive/text_iarchive.hpp>
-
 #include <iostream>
-#include <sstream>
+#include <vector>
+#include <string>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include <utility>
+#include <cmath>
 
 namespace bpt = boost::property_tree;
 
 
 
 
-bool extractMatCompress(const bpt::ptree& nodeBscan, SimpleMatCompress& compressedMat)
+namespace
 {
-	boost::optional<const bpt::ptree&> matCompressNodeOptional = nodeBscan.get_child_optional("matCompress");
-	if(!matCompressNodeOptional)
-		return false;
+	/// B-scan IDs (0 based), both included
+	struct BScanRange
+	{
+		int first = 0;
+		int last  = std::numeric_limits<int>::max();
+
+		bool contains(int id) const                                 { return first <= id && id <= last; }
+	};
+
+	struct SegmentationVolume
+	{
+		std::vector<std::pair<int, SimpleMatCompress>> bscans;     ///< B-scan ID and mask
+		int rows  = 0;
+		int cols  = 0;
+		int maxId = -1;
+	};
 
-	std::string matCompressStr = matCompressNodeOptional->get_value<std::string>(std::string());
 
-	if(matCompressStr.size() < 2)
-		return false;
+	std::string getString(const mxArray* mat)
+	{
+		const mxChar* strPtr = reinterpret_cast<const mxChar*>(mxGetData(mat));
+		std::size_t strLength = mxGetNumberOfElements(mat);
+		return std::string(strPtr, strPtr+strLength);
+	}
+
+	/// decodes each mask once, B-scans with a different size than the first one are skipped
+	/// (empty B-scans are not saved in the marker file, so the masks are identified by their ID)
+	void readSegmentation(const std::string& filename, const BScanRange& range, SegmentationVolume& volume, std::string& decodeBuffer)
+	{
+		bpt::ptree octmarkerTree;
+		OctMarkerIO markerIO(&octmarkerTree);
+		if(!markerIO.loadDefaultMarker(filename))
+			throw std::runtime_error("can't open marker file for " + filename);
+
+		const bpt::ptree& nodeSeries = octmarkerTree.get_child("Patient.Study.Series"  );
+		const bpt::ptree& nodeILM    = nodeSeries   .get_child("SegmentationMarker.ILM");
+
+		volume.bscans.reserve(nodeILM.size());
+		for(const std::pair<const std::string, bpt::ptree>& nodeBscanPair : nodeILM)
+		{
+			if(nodeBscanPair.first != "BScan")
+				continue;
+
+			const bpt::ptree& nodeBscan = nodeBscanPair.second;
+			const int bscanId = nodeBscan.get<int>("ID", -1);
+			if(bscanId < 0 || !range.contains(bscanId))
+				continue;
 
-	std::stringstream ioa(matCompressStr);
-	boost::archive::text_iarchive oa(ioa);
-	oa >> compressedMat;
-	return true;
+			boost::optional<const bpt::ptree&> matCompressNode = nodeBscan.get_child_optional("matCompress");
+			if(!matCompressNode)
+				continue;
+
+			volume.bscans.emplace_back(bscanId, SimpleMatCompress());
+			SimpleMatCompress& compressedMat = volume.bscans.back().second;
+			if(!compressedMat.fromString(matCompressNode->data(), decodeBuffer))
+			{
+				volume.bscans.pop_back();
+				continue;
+			}
+
+			if(volume.bscans.size() == 1)
+			{
+				volume.rows = compressedMat.getRows();
+				volume.cols = compressedMat.getCols();
+			}
+			else if(volume.rows != compressedMat.getRows() || volume.cols != compressedMat.getCols())
+			{
+				volume.bscans.pop_back();
+				continue;
+			}
+
+			volume.maxId = std::max(volume.maxId, bscanId);
+		}
+	}
 }
 
+
+/**
+ * seg = read_seg(filename)
+ * seg = read_seg(filename, [firstBScan lastBScan])
+ * seg = read_seg({filename1, filename2, ...}, ...)
+ *
+ * The B-scan range is 1 based and inclusive. Slice k of the result is B-scan firstBScan+k-1
+ * (without range B-scan k), B-scans without mask are zero. With a cell array of filenames the
+ * result is 4-D, the last dimension is the file.
+ */
 void mexFunction(int            nlhs  ,
                  mxArray*       plhs[],
                  int            nrhs  ,
@@ -45,9 +120,9 @@ void mexFunction(int            nlhs  ,
 {
 	/* Check for proper number of arguments */
 
-	if(nrhs != 1)
+	if(nrhs < 1 || nrhs > 2)
 	{
-		mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", "MEXCPP requires 1 input arguments");
+		mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", "MEXCPP requires 1 or 2 input arguments");
 		return;
 	}
 	if(nlhs > 1)
@@ -58,84 +133,116 @@ void mexFunction(int            nlhs  ,
 
 // 	mexPrintf("Read segmentation\n");
 
-	if(!mxIsChar(prhs[0]))
+	// Filenames
+	std::vector<std::string> filenames;
+	const bool multipleFiles = mxIsCell(prhs[0]);
+	if(multipleFiles)
+	{
+		const std::size_t numFiles = mxGetNumberOfElements(prhs[0]);
+		for(std::size_t i = 0; i < numFiles; ++i)
+		{
+			const mxArray* fnMat = mxGetCell(prhs[0], i);
+			if(!fnMat || !mxIsChar(fnMat))
+			{
+				mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", "requires a cell array of filenames");
+				return;
+			}
+			filenames.push_back(getString(fnMat));
+		}
+	}
+	else if(mxIsChar(prhs[0]))
+		filenames.push_back(getString(prhs[0]));
+	else
 	{
 		mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", "requires filename");
 		return;
 	}
-	// Filename
-	mxChar* fnPtr = (mxChar*) mxGetPr(prhs[0]);
-	std::size_t fnLength = mxGetN(prhs[0]);
-	std::string filename(fnPtr, fnPtr+fnLength);
 
-
-	bpt::ptree octmarkerTree;
-	SimpleMatCompress compressedMat;
-
-	OctMarkerIO markerIO(&octmarkerTree);
-	if(!markerIO.loadDefaultMarker(filename))
+	// B-scan range
+	BScanRange range;
+	const bool hasRange = nrhs == 2;
+	if(hasRange)
 	{
-		mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", "can't open marker file for %s", filename.c_str());
-		return;
+		if(!mxIsDouble(prhs[1]) || mxGetNumberOfElements(prhs[1]) != 2)
+		{
+			mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", "B-scan range requires [first last]");
+			return;
+		}
+		const double* rangePtr = mxGetPr(prhs[1]);
+		const double  first    = rangePtr[0];
+		const double  last     = rangePtr[1];
+		if(!std::isfinite(first) || !std::isfinite(last) || first < 1 || first > last || last > std::numeric_limits<int>::max())
+		{
+			mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", "B-scan range requires 1 <= first <= last");
+			return;
+		}
+		range.first = static_cast<int>(first) - 1;
+		range.last  = static_cast<int>(last ) - 1;
 	}
 
+
 	mxArray* resultMat = nullptr;
 
 	try
 	{
-		bpt::ptree& nodeSeries = octmarkerTree.get_child("Patient.Study.Series"  );
-		bpt::ptree& nodeILM    = nodeSeries   .get_child("SegmentationMarker.ILM");
+		std::vector<SegmentationVolume> volumes(filenames.size());
+		std::string decodeBuffer;
 
 		mwSize numBscans = 0;
 		mwSize rows = 0;
 		mwSize cols = 0;
 
-		// count BScans
-		for(const std::pair<const std::string, bpt::ptree>& nodeBscanPair : nodeILM)
+		for(std::size_t i = 0; i < filenames.size(); ++i)
 		{
-			if(nodeBscanPair.first != "BScan")
-				continue;
-
-			if(!extractMatCompress(nodeBscanPair.second, compressedMat))
+			SegmentationVolume& volume = volumes[i];
+			readSegmentation(filenames[i], range, volume, decodeBuffer);
+			if(volume.bscans.empty())
 				continue;
 
-			if(numBscans == 0)
+			if(rows == 0 && cols == 0)
 			{
-				rows = compressedMat.getRows();
-				cols = compressedMat.getCols();
+				rows = static_cast<mwSize>(volume.rows);
+				cols = static_cast<mwSize>(volume.cols);
 			}
-			else if(rows != compressedMat.getRows() || cols != compressedMat.getCols())
-				continue;
+			else if(rows != static_cast<mwSize>(volume.rows) || cols != static_cast<mwSize>(volume.cols))
+				throw std::runtime_error("B-scan size of " + filenames[i] + " differs from the previous files");
 
-			++numBscans;
+			if(!hasRange)
+				numBscans = std::max(numBscans, static_cast<mwSize>(volume.maxId) + 1);
 		}
+		if(hasRange)
+			numBscans = static_cast<mwSize>(range.last - range.first) + 1;
 
 		// create output mat
-		const mwSize dims[] = {cols, rows, numBscans};
-		const mwSize dimNum = sizeof(dims)/sizeof(dims[0]);
+		const mwSize dims[] = {cols, rows, numBscans, static_cast<mwSize>(filenames.size())};
+		const mwSize dimNum = multipleFiles ? 4 : 3;
 		resultMat = mxCreateNumericArray(dimNum, dims, MatlabType<uint8_t>::classID, mxREAL);
-		uint8_t* dataPtr = reinterpret_cast<uint8_t*>(mxGetPr(resultMat));
+		uint8_t* dataPtr = reinterpret_cast<uint8_t*>(mxGetData(resultMat));
 
-		// fill output mat
-		for(const std::pair<const std::string, bpt::ptree>& nodeBscanPair : nodeILM)
+		// fill output mat, slice of a B-scan is its ID relative to the range
+		const std::size_t bscanSize = rows*cols;
+		for(const SegmentationVolume& volume : volumes)
 		{
-			if(nodeBscanPair.first != "BScan")
-				continue;
-
-			if(!extractMatCompress(nodeBscanPair.second, compressedMat))
-				continue;
-
-			if(rows != compressedMat.getRows() || cols != compressedMat.getCols())
-				continue;
-
-			compressedMat.writeToMat(dataPtr, rows, cols);
-			dataPtr += rows*cols;
+			for(const std::pair<int, SimpleMatCompress>& bscan : volume.bscans)
+			{
+				uint8_t* bscanPtr = dataPtr + bscanSize*static_cast<std::size_t>(bscan.first - range.first);
+				if(!bscan.second.writeToMat(bscanPtr, volume.rows, volume.cols))
+					throw std::runtime_error("can't decode mask of B-scan " + std::to_string(bscan.first + 1));
+			}
+			dataPtr += bscanSize*numBscans;
 		}
-
-
+	}
+	catch(const std::exception& e)
+	{
+		if(resultMat)
+			mxDestroyArray(resultMat);
+		mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", "Error while reading file: %s", e.what());
+		return;
 	}
 	catch(...)
 	{
+		if(resultMat)
+			mxDestroyArray(resultMat);
 		mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", "Error while reading file");
 		return;
 	}